@@ -0,0 +1,19 @@
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include "gpio_utils.h"
+
+/* Kept apart from gpio_utils.cpp, as the kernel's termios2 can't be mixed with the libc termios header */
+
+bool SerialReader::uartSetBaud(const int fd, const int baud) {
+  termios2 options{};
+  if (baud <= 0 || ioctl(fd, TCGETS2, &options) != 0) {
+    return false;
+  }
+  options.c_cflag &= ~CBAUD;
+  options.c_cflag |= BOTHER;
+  options.c_cflag &= ~(CBAUD << IBSHIFT);
+  options.c_cflag |= BOTHER << IBSHIFT;
+  options.c_ispeed = baud;
+  options.c_ospeed = baud;
+  return ioctl(fd, TCSETS2, &options) == 0;
+}
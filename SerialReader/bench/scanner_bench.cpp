@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "../parser.h"
+#include "../runner.h"
+#include "../scanner.h"
+
+/* Throughput benchmark of the serial frame scanner against the former per-byte state machine of Runner::loop. */
+
+static std::string makeStream(const size_t payloadSize) {
+  std::string stream = "\x16\x16\x16$|Choose mode:\r\n 0: memory dump (bit)|: 0\r\nPUF init complete\r\n\x16\x16\x16&|0000000,";
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> byte(0, 255);
+  char last = 0;
+  for (size_t i = 0; i < payloadSize; i++) {
+    char c = static_cast<char>(byte(rng));
+    // The old state machine reacts to markers inside the payload, so keep both paths on the same data
+    if ((last == '|' && (c == '&' || c == '$' || c == ':')) || (last == '$' && (c == '|' || c == '&')) ||
+        (last == '&' && c == '|'))
+      c = '+';
+    stream += c;
+    last = c;
+  }
+  return stream + "|&" + std::to_string(payloadSize / 4) + "|$\r\n";
+}
+
+/* The loop body as it was before the scanner, without the thread handling. */
+static size_t legacy(const std::string& stream, std::ostream& output) {
+  char lastChar = ' ', in;
+  bool writePuf = false, interrupt = false;
+  int charCount = 0;
+  std::ostringstream log;
+  for (size_t offset = 0; offset < stream.size() && !interrupt; offset += BUFFER_SIZE) {
+    const size_t numBytes = std::min<size_t>(BUFFER_SIZE, stream.size() - offset);
+    const char* readBuf = stream.data() + offset;
+    for (size_t i = 0; i < numBytes && !interrupt; i++) {
+      in = readBuf[i];
+      if (!writePuf) {
+        log << ((in < 32 || in > 126) && in != 10 && in != 13 ? ' ' : in);
+      }
+      if ('&' == lastChar && '|' == in) {
+        writePuf = true;
+      } else if ('|' == lastChar && '&' == in) {
+        writePuf = false;
+      } else if ('|' == lastChar && '$' == in) {
+        interrupt = true;
+      }
+      if (writePuf && charCount > 1) {
+        output << lastChar;
+      }
+      lastChar = in;
+      if (writePuf) {
+        ++charCount;
+        if (charCount % FLUSH_INTERVAL == 0) output.flush();
+      }
+    }
+  }
+  return charCount;
+}
+
+static size_t scanner(const std::string& stream, std::ostream& output) {
+  SerialReader::FrameScanner scanner;
+  SerialReader::FrameScanner::Chunk chunk;
+  bool interrupt = false;
+  size_t payloadCount = 0;
+  std::ostringstream log;
+  for (size_t offset = 0; offset < stream.size() && !interrupt; offset += BUFFER_SIZE) {
+    std::string_view received(stream.data() + offset, std::min<size_t>(BUFFER_SIZE, stream.size() - offset));
+    while (!interrupt && scanner.next(received, chunk)) {
+      if (chunk.marker == SerialReader::Marker::NONE) {
+        if (chunk.payload) {
+          output.write(chunk.data.data(), static_cast<std::streamsize>(chunk.data.size()));
+          const size_t before = payloadCount;
+          payloadCount += chunk.data.size();
+          if (payloadCount / FLUSH_INTERVAL != before / FLUSH_INTERVAL) output.flush();
+        } else {
+          log << chunk.data;
+        }
+      } else if (chunk.marker == SerialReader::Marker::FINISHED) {
+        interrupt = true;
+      }
+    }
+  }
+  return payloadCount;
+}
+
+template <class F>
+static double measure(const char* name, F&& f, const std::string& stream, std::string& result) {
+  std::ostringstream output;
+  const auto start = std::chrono::steady_clock::now();
+  f(stream, output);
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  result = output.str();
+  const double rate = static_cast<double>(stream.size()) / elapsed.count() / (1 << 20);
+  std::cout << name << ": " << elapsed.count() * 1000 << " ms, " << rate << " MiB/s" << std::endl;
+  return rate;
+}
+
+int main(const int argc, const char** argv) {
+  const size_t size = (argc > 1 ? std::stoul(argv[1]) : 16) << 20;
+  const std::string stream = makeStream(size);
+  std::cout << "Scanning " << stream.size() << " bytes in chunks of " << BUFFER_SIZE << " bytes" << std::endl;
+
+  std::string legacyOut, scannerOut;
+  const double legacyRate = measure("per-byte", legacy, stream, legacyOut);
+  const double scannerRate = measure("scanner ", scanner, stream, scannerOut);
+  std::cout << "Speedup: " << scannerRate / legacyRate << "x" << std::endl;
+
+  if (legacyOut != scannerOut) {
+    std::cerr << "Payloads differ (" << legacyOut.size() << " vs " << scannerOut.size() << " bytes)" << std::endl;
+    return 1;
+  }
+  return 0;
+}
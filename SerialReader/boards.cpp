@@ -0,0 +1,82 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "boards.h"
+#include "eventloop.h"
+#include "logger.h"
+#include "runner.h"
+#include "writer.h"
+
+namespace {
+  struct BoardRun {
+    SerialReader::Board board;
+    std::unique_ptr<SerialReader::Runner> runner;
+    std::unique_ptr<SerialReader::AsyncWriter> writer;
+    std::unique_ptr<std::ostream> output;
+    int count = 0;
+  };
+
+  std::string boardStats(const BoardRun& run) {
+    const SerialReader::RunnerStats& stats = run.runner->stats();
+    const auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(stats.transferTime).count();
+    std::ostringstream oss;
+    oss << "[" << run.runner->getName() << "] " << stats.measurements << " measurements, " << stats.panics
+        << " panics, " << stats.payloadBytes << " bytes";
+    if (seconds > 0) {
+      oss << ", " << static_cast<double>(stats.payloadBytes) / seconds << " bytes/s while transferring";
+    }
+    return oss.str();
+  }
+}
+
+void SerialReader::runBoards(Parser& parser) {
+  const std::shared_ptr<std::ostream> log = Runner::openLog();
+  EventLoop events;
+  std::vector<std::unique_ptr<BoardRun>> runs;
+  size_t remaining = parser.getBoards().size();
+
+  for (const Board& board : parser.getBoards()) {
+    auto run = std::make_unique<BoardRun>();
+    run->board = board;
+    run->runner = std::make_unique<Runner>(board.serialPort.c_str(), parser.getGpioChip().c_str(),
+                                           board.usbPort, parser.getBaudRate(), parser.getFlowControl(),
+                                           board.serialPort, log);
+    runs.push_back(std::move(run));
+  }
+
+  std::function<void(BoardRun&)> measure = [&](BoardRun& run) {
+    run.runner->powerOff();
+    events.schedule(std::chrono::seconds(parser.getUSBSleepTime()), [&] {
+      run.output.reset();
+      run.writer = std::make_unique<AsyncWriter>(run.board.outPrefix + std::to_string(run.count) + ".bin");
+      run.output = std::make_unique<std::ostream>(run.writer.get());
+      run.runner->powerOn();
+      run.runner->start(events, parser, *run.output, run.count, [&](const bool running) {
+        log_live(boardStats(run) + "\n", *log);
+        if (running) {
+          measure(run);
+        } else {
+          if (--remaining == 0) {
+            events.stop();
+          }
+        }
+      });
+    });
+  };
+
+  for (const auto& run : runs) {
+    measure(*run);
+  }
+  events.run();
+  if (!events.getError().empty()) {
+    log_data("Event loop failed, " + events.getError() + ".", *log);
+  }
+
+  log_data("All boards finished:", *log);
+  for (const auto& run : runs) {
+    log_live(boardStats(*run) + "\n", *log);
+    run->runner->release();
+  }
+}
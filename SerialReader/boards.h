@@ -0,0 +1,11 @@
+#pragma once
+
+#include "parser.h"
+
+namespace SerialReader {
+  /**
+   * Runs all boards given with --board concurrently on one event loop. Every board is power cycled and measured on
+   * its own schedule; while one of them decays, the others keep transferring.
+   */
+  void runBoards(Parser& parser);
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include "chunk.h"
+
+static constexpr std::string_view MAGIC("PUF\x16", 4);
+static constexpr char TAGGED = 0x17;
+static constexpr char SYN = 0x16;
+// Longest possible trailer "|&<cells>|$"
+static constexpr size_t TAIL_SIZE = 14;
+
+static constexpr std::array<uint32_t, 256> CRC_TABLE = [] {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    table[i] = c;
+  }
+  return table;
+}();
+
+static uint32_t readBE(const std::string_view data, const size_t size) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value = value << 8 | static_cast<uint8_t>(data[i]);
+  }
+  return value;
+}
+
+uint32_t SerialReader::crc32(const std::string_view data, uint32_t crc) {
+  crc = ~crc;
+  for (const char c : data) {
+    crc = CRC_TABLE[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ crc >> 8;
+  }
+  return ~crc;
+}
+
+void SerialReader::ChunkDecoder::feed(const std::string_view input) {
+  if (state == State::DONE) {
+    buffer.append(input);
+    return;
+  }
+  if (state == State::HEADER) {
+    const size_t comma = input.find(',');
+    output.write(input.data(), static_cast<std::streamsize>(comma == std::string_view::npos ? input.size() : comma + 1));
+    if (comma == std::string_view::npos) {
+      return;
+    }
+    state = State::CHUNKS;
+    buffer.append(input.substr(comma + 1));
+  } else {
+    buffer.append(input);
+  }
+
+  while (decode()) {}
+  if (state != State::DONE && pos > 0) {
+    buffer.erase(0, pos);
+    skipTo = skipTo > pos ? skipTo - pos : 0;
+    pos = 0;
+  }
+}
+
+void SerialReader::ChunkDecoder::resume() {
+  state = State::CHUNKS;
+  resumed = true;
+  buffer.clear();
+  pos = 0;
+  skipTo = 0;
+}
+
+bool SerialReader::ChunkDecoder::stall() {
+  if (state != State::CHUNKS) {
+    return done();
+  }
+  const std::string_view data = rest();
+  if (const size_t end = trailer(data); end != std::string_view::npos) {
+    if (findMagic(data.substr(0, end)) != std::string_view::npos) {
+      ++errors;
+    }
+    pos += end;
+    endOfChunks(0, trailerSize(data.substr(end)));
+  }
+  return done();
+}
+
+bool SerialReader::ChunkDecoder::framed(const std::string_view before) {
+  return !before.empty() && before.back() == SYN;
+}
+
+void SerialReader::ChunkDecoder::finish() {
+  static const char zeros[CHUNK_SIZE] = {};
+  const uint32_t chunks = std::max(totalChunks, pending.empty() ? nextSeq : pending.rbegin()->first + 1);
+  while (nextSeq < chunks) {
+    if (const auto it = pending.find(nextSeq); it != pending.end()) {
+      write(it->second);
+      pending.erase(it);
+      continue;
+    }
+    const uint64_t offset = static_cast<uint64_t>(nextSeq) * CHUNK_SIZE;
+    const uint64_t size = totalSize > offset ? std::min<uint64_t>(CHUNK_SIZE, totalSize - offset) : CHUNK_SIZE;
+    lost.push_back(nextSeq);
+    write(std::string_view(zeros, size));
+  }
+}
+
+std::vector<uint32_t> SerialReader::ChunkDecoder::missing() const {
+  std::vector<uint32_t> result;
+  const uint32_t chunks = std::max(totalChunks, pending.empty() ? nextSeq : pending.rbegin()->first + 1);
+  for (uint32_t seq = nextSeq; seq < chunks; seq++) {
+    if (!pending.contains(seq)) {
+      result.push_back(seq);
+    }
+  }
+  return result;
+}
+
+bool SerialReader::ChunkDecoder::decode() {
+  const std::string_view data = std::string_view(buffer).substr(pos);
+  const size_t start = findMagic(data);
+  if (start == std::string_view::npos) {
+    // The rest of a broken chunk is still payload
+    const size_t skip = std::min(skipTo > pos ? skipTo - pos : 0, data.size());
+    if (const size_t end = trailer(data.substr(skip)); end != std::string_view::npos) {
+      pos += skip + end;
+      endOfChunks(0, trailerSize(data.substr(skip + end)));
+    } else {
+      // Keep what could be the beginning of the next magic or of the trailer
+      pos += data.size() < TAIL_SIZE ? 0 : data.size() - TAIL_SIZE;
+    }
+    return false;
+  }
+  pos += start;
+  const std::string_view chunk = data.substr(start);
+  if (chunk.size() < CHUNK_HEADER_SIZE + CHUNK_TAG_SIZE) {
+    return false;
+  }
+  const bool tagged = chunk[3] == TAGGED;
+  const size_t headerSize = CHUNK_HEADER_SIZE + (tagged ? CHUNK_TAG_SIZE : 0);
+  const uint32_t seq = readBE(chunk.substr(4), 4);
+  const uint32_t length = readBE(chunk.substr(12), 2);
+  if (length > CHUNK_SIZE) {
+    ++pos;
+    return true;
+  }
+  if (chunk.size() < headerSize + length + CHUNK_CRC_SIZE) {
+    // A damaged length can make the decoder wait for bytes which never come, stall() gives up on them
+    return false;
+  }
+  const std::string_view payload = chunk.substr(headerSize, length);
+  const uint32_t crc = readBE(chunk.substr(headerSize + length), CHUNK_CRC_SIZE);
+  if (crc32(chunk.substr(MAGIC.size(), headerSize - MAGIC.size() + length)) != crc) {
+    // Most likely a damaged chunk, but the magic could also have been part of a payload: search on from here
+    ++errors;
+    skipTo = std::max(skipTo, pos + headerSize + length + CHUNK_CRC_SIZE);
+    ++pos;
+    return true;
+  }
+  pos += headerSize + length + CHUNK_CRC_SIZE;
+
+  if (length == 0) {
+    endOfChunks(seq, readBE(chunk.substr(8), 4));
+    return false;
+  }
+  if (tagged && seq >= nextSeq) {
+    chunkTags.try_emplace(seq, Tag{readBE(chunk.substr(8), 4), readBE(chunk.substr(CHUNK_HEADER_SIZE), 4)});
+  }
+  accept(seq, payload);
+  return true;
+}
+
+size_t SerialReader::ChunkDecoder::findMagic(const std::string_view data) {
+  const std::string_view prefix = MAGIC.substr(0, 3);
+  for (size_t start = data.find(prefix); start != std::string_view::npos; start = data.find(prefix, start + 1)) {
+    // An incomplete magic at the end could still become one
+    if (start + 3 == data.size() || data[start + 3] == MAGIC[3] || data[start + 3] == TAGGED) {
+      return start;
+    }
+  }
+  return std::string_view::npos;
+}
+
+size_t SerialReader::ChunkDecoder::trailer(const std::string_view data) {
+  // "|&<cells>" and the line break or "|$" behind it
+  for (size_t end = data.find("|&"); end != std::string_view::npos; end = data.find("|&", end + 1)) {
+    const size_t digits = data.find_first_not_of("0123456789", end + 2);
+    if (digits != std::string_view::npos && digits > end + 2 && digits - end <= TAIL_SIZE &&
+        (data[digits] == '\r' || data[digits] == '\n' || data[digits] == '|')) {
+      return end;
+    }
+  }
+  return std::string_view::npos;
+}
+
+uint64_t SerialReader::ChunkDecoder::trailerSize(const std::string_view trailer) {
+  return std::stoull(std::string(trailer.substr(2, TAIL_SIZE))) * 4;
+}
+
+void SerialReader::ChunkDecoder::endOfChunks(const uint32_t chunks, const uint64_t size) {
+  state = State::DONE;
+  if (size == 0) {
+    return;
+  }
+  totalSize = size;
+  totalChunks = std::max<uint32_t>(chunks, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+void SerialReader::ChunkDecoder::accept(const uint32_t seq, const std::string_view payload) {
+  if (seq < nextSeq || pending.contains(seq)) {
+    return;
+  }
+  bytes += payload.size();
+  if (resumed) {
+    ++resent;
+  }
+  if (seq > nextSeq) {
+    pending.emplace(seq, payload);
+    return;
+  }
+  write(payload);
+  while (!pending.empty() && pending.begin()->first == nextSeq) {
+    write(pending.begin()->second);
+    pending.erase(pending.begin());
+  }
+}
+
+void SerialReader::ChunkDecoder::write(const std::string_view payload) {
+  output.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+  ++nextSeq;
+}
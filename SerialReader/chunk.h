@@ -0,0 +1,160 @@
+#pragma once
+
+#define CHUNK_SIZE 1024
+#define CHUNK_HEADER_SIZE 14
+#define CHUNK_CRC_SIZE 4
+#define CHUNK_TAG_SIZE 4
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SerialReader {
+  uint32_t crc32(std::string_view data, uint32_t crc = 0);
+
+  /**
+   * Decodes the chunked PUF readout of the firmware (see getpuf/chunk.c):
+   * the text header up to the first ',', then chunks of
+   *   magic "PUF\x16" | seq (4) | address (4) | length (2) | payload | CRC32 (4)
+   * up to an empty end chunk, which carries the total payload size instead of an address. Tagged chunks have the
+   * magic "PUF\x17" and a tag (4) after the length, e.g. the elapsed decay time of a staggered readout (mode 8).
+   * A corrupted chunk is
+   * dropped and the decoder looks for the next magic right after the broken one, so it loses nothing but that chunk.
+   * If the end chunk itself is lost, the "|&" trailer of the firmware ends the readout. Payload bytes can look like a
+   * trailer, so it is only looked for past the announced length of every chunk seen, and within a chunk still
+   * waiting for its bytes only once the stream has stalled (see stall()).
+   * Payloads are written to the output in sequence order. Chunks after a gap are held back until the missing ones
+   * have been sent again (see resume()) or finish() gives up on them and writes zeros instead.
+   */
+  class ChunkDecoder {
+  public:
+    struct Tag {
+      uint32_t address;
+      uint32_t tag;
+    };
+
+    explicit ChunkDecoder(std::ostream& output) : output(output) {}
+
+    /**
+     * Consumes received bytes until the end chunk. Everything after it is kept for rest().
+     */
+    void feed(std::string_view input);
+
+    /**
+     * Accepts chunks again after the end chunk, for those the firmware sends again on request.
+     */
+    void resume();
+
+    /**
+     * No more bytes arrived for a while: gives up on the chunks still waiting for their bytes, e.g. one with a damaged
+     * length, and ends the readout at a trailer among them. Returns whether the readout is done.
+     */
+    bool stall();
+
+    /**
+     * Whether the text sent right before the "&|" of a readout announces chunks: puf_header (getpuf/GetPuf.c) sends
+     * SYN bytes first, text readouts like mode 1 don't.
+     */
+    static bool framed(std::string_view before);
+
+    /**
+     * Writes everything held back, with zeros for the chunks still missing.
+     */
+    void finish();
+
+    [[nodiscard]] bool done() const {
+      return state == State::DONE;
+    }
+
+    /**
+     * The bytes received after the end chunk, i.e. the text following the readout.
+     */
+    [[nodiscard]] std::string_view rest() const {
+      return std::string_view(buffer).substr(pos);
+    }
+
+    [[nodiscard]] size_t payloadBytes() const {
+      return bytes;
+    }
+
+    /**
+     * Magics followed by a broken chunk, including magics which turned out to be part of a payload.
+     */
+    [[nodiscard]] size_t crcErrors() const {
+      return errors;
+    }
+
+    /**
+     * Chunks which only arrived after resume().
+     */
+    [[nodiscard]] size_t resentChunks() const {
+      return resent;
+    }
+
+    /**
+     * Sequence numbers of the chunks not received yet, as far as known.
+     */
+    [[nodiscard]] std::vector<uint32_t> missing() const;
+
+    /**
+     * Address and tag of every tagged chunk received, by sequence number.
+     */
+    [[nodiscard]] const std::map<uint32_t, Tag>& tags() const {
+      return chunkTags;
+    }
+
+    /**
+     * Sequence numbers of the chunks finish() had to fill with zeros.
+     */
+    [[nodiscard]] const std::vector<uint32_t>& filled() const {
+      return lost;
+    }
+
+  private:
+    enum class State {
+      HEADER,
+      CHUNKS,
+      DONE
+    };
+
+    bool decode();
+
+    /**
+     * Position of the firmware's "|&" trailer in data, if complete.
+     */
+    static size_t trailer(std::string_view data);
+
+    /**
+     * Payload size announced by a trailer, 4 bytes per cell.
+     */
+    static uint64_t trailerSize(std::string_view trailer);
+
+    void endOfChunks(uint32_t chunks, uint64_t size);
+
+    void accept(uint32_t seq, std::string_view payload);
+
+    static size_t findMagic(std::string_view data);
+
+    void write(std::string_view payload);
+
+    std::ostream& output;
+    State state = State::HEADER;
+    bool resumed = false;
+    std::string buffer;
+    size_t pos = 0;
+    // End of the announced length of the last chunk seen in buffer, no trailer is looked for before it
+    size_t skipTo = 0;
+    uint32_t nextSeq = 0;
+    std::map<uint32_t, std::string> pending;
+    uint32_t totalChunks = 0;
+    uint64_t totalSize = 0;
+    size_t bytes = 0;
+    size_t errors = 0;
+    size_t resent = 0;
+    std::vector<uint32_t> lost;
+    std::map<uint32_t, Tag> chunkTags;
+  };
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "eventloop.h"
+
+SerialReader::EventLoop::EventLoop()
+  : epollFd(epoll_create1(EPOLL_CLOEXEC)),
+    timerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+  if (epollFd < 0) {
+    fail("epoll_create1");
+    return;
+  }
+  if (timerFd < 0) {
+    fail("timerfd_create");
+    return;
+  }
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = timerFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event) < 0) {
+    fail("epoll_ctl");
+  }
+}
+
+SerialReader::EventLoop::~EventLoop() {
+  if (timerFd >= 0) close(timerFd);
+  if (epollFd >= 0) close(epollFd);
+}
+
+void SerialReader::EventLoop::fail(const char* call) {
+  if (error.empty()) {
+    error = std::string(call) + ": " + std::strerror(errno);
+  }
+  running = false;
+}
+
+bool SerialReader::EventLoop::watch(const int fd, Handler handler) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  const bool known = handlers.contains(fd);
+  if (epoll_ctl(epollFd, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0) {
+    fail("epoll_ctl");
+    return false;
+  }
+  handlers[fd] = std::move(handler);
+  return true;
+}
+
+void SerialReader::EventLoop::unwatch(const int fd) {
+  // The descriptor may already be closed, which removes it from the epoll set as well
+  if (handlers.erase(fd) > 0 && epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != EBADF &&
+      errno != ENOENT) {
+    fail("epoll_ctl");
+  }
+}
+
+void SerialReader::EventLoop::schedule(const Clock::duration delay, std::function<void()> callback) {
+  timers.emplace(Clock::now() + delay, std::move(callback));
+  armTimer();
+}
+
+void SerialReader::EventLoop::armTimer() {
+  itimerspec spec{};
+  if (!timers.empty()) {
+    const auto left = std::max(timers.begin()->first - Clock::now(), Clock::duration(1));
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(left);
+    spec.it_value.tv_sec = seconds.count();
+    spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(left - seconds).count();
+  }
+  if (timerfd_settime(timerFd, 0, &spec, nullptr) < 0) {
+    fail("timerfd_settime");
+  }
+}
+
+void SerialReader::EventLoop::fireTimers() {
+  uint64_t expirations;
+  while (read(timerFd, &expirations, sizeof(expirations)) > 0) {}
+  const auto now = Clock::now();
+  while (running && !timers.empty() && timers.begin()->first <= now) {
+    auto callback = std::move(timers.begin()->second);
+    timers.erase(timers.begin());
+    callback();
+  }
+  armTimer();
+}
+
+void SerialReader::EventLoop::run() {
+  constexpr int MAX_EVENTS = 8;
+  epoll_event events[MAX_EVENTS];
+  if (!error.empty()) {
+    return;
+  }
+  running = true;
+  while (running) {
+    const int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      fail("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < ready && running; i++) {
+      const int fd = events[i].data.fd;
+      if (fd == timerFd) {
+        fireTimers();
+      } else if (const auto handler = handlers.find(fd); handler != handlers.end()) {
+        // Copy, the handler may unwatch its own descriptor
+        const Handler current = handler->second;
+        current(events[i].events);
+      }
+    }
+  }
+  running = false;
+}
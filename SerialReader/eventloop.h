@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace SerialReader {
+  /**
+   * Single-threaded epoll loop for file descriptors and one-shot timers.
+   * All timers share one timerfd armed for the earliest deadline, so a loop that only waits for a slow sender sleeps
+   * in epoll_wait without any periodic wakeups.
+   */
+  class EventLoop {
+  public:
+    using Handler = std::function<void(uint32_t events)>;
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    ~EventLoop();
+
+    /**
+     * Calls handler with the epoll event mask whenever fd becomes readable or fails.
+     * Returns false if fd can't be watched, the loop is stopped then (see getError()).
+     */
+    bool watch(int fd, Handler handler);
+
+    void unwatch(int fd);
+
+    /**
+     * Calls callback once after delay has passed.
+     */
+    void schedule(Clock::duration delay, std::function<void()> callback);
+
+    /**
+     * Dispatches events until stop() is called from one of the handlers or a system call of the loop fails.
+     */
+    void run();
+
+    void stop() {
+      running = false;
+    }
+
+    [[nodiscard]] bool isRunning() const {
+      return running;
+    }
+
+    /**
+     * The first system call of the loop which failed and its errno, as "<call>: <message>", empty if none did.
+     */
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+
+  private:
+    void fail(const char* call);
+
+    void armTimer();
+
+    void fireTimers();
+
+    const int epollFd;
+    const int timerFd;
+    bool running = false;
+    std::string error;
+    std::unordered_map<int, Handler> handlers;
+    std::multimap<Clock::time_point, std::function<void()>> timers;
+  };
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include "chunk.h"
+#include "expander.h"
+
+// Repeated words are written this many at a time
+static constexpr uint32_t FILL_WORDS = 1024;
+
+static void repeatWord(std::string& words, const uint32_t value) {
+  words.clear();
+  for (uint32_t i = 0; i < FILL_WORDS; i++) {
+    words += static_cast<char>(value >> 24);
+    words += static_cast<char>(value >> 16);
+    words += static_cast<char>(value >> 8);
+    words += static_cast<char>(value);
+  }
+}
+
+void SerialReader::ReadoutExpander::finish() {
+  if (encoding != Encoding::DENSE && state != State::PASS) {
+    fill(total);
+  }
+}
+
+SerialReader::ReadoutExpander::int_type SerialReader::ReadoutExpander::overflow(const int_type ch) {
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    const char c = traits_type::to_char_type(ch);
+    xsputn(&c, 1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize SerialReader::ReadoutExpander::xsputn(const char* s, const std::streamsize count) {
+  std::streamsize i = 0;
+  while (i < count && state == State::HEADER) {
+    head += s[i++];
+    if (head.back() == ',') {
+      header();
+    }
+  }
+  if (state == State::PASS) {
+    output.write(s + i, count - i);
+    return count;
+  }
+  for (; i < count; i++) {
+    put(static_cast<uint8_t>(s[i]));
+  }
+  return count;
+}
+
+void SerialReader::ReadoutExpander::header() {
+  const size_t colon = head.find(':');
+  const size_t second = colon == std::string::npos ? colon : head.find(':', colon + 1);
+  const size_t semicolon = head.find(';');
+  size_t end = head.size() - 1;
+  try {
+    if (second != std::string::npos) {
+      initValue = std::stoul(head.substr(colon + 1, second - colon - 1), nullptr, 16);
+      total = std::stoul(head.substr(second + 1), nullptr, 16);
+      encoding = Encoding::SPARSE;
+      end = colon;
+    } else if (semicolon != std::string::npos) {
+      initValue = 0;
+      total = std::stoul(head.substr(semicolon + 1), nullptr, 16);
+      encoding = Encoding::RLE;
+      end = semicolon;
+    }
+  } catch (const std::exception&) {
+    // Not an encoded readout after all, keep the header as it is
+    encoding = Encoding::DENSE;
+  }
+  if (encoding == Encoding::DENSE || keepEncoded) {
+    output.write(head.data(), static_cast<std::streamsize>(head.size()));
+    state = State::PASS;
+    return;
+  }
+  output.write(head.data(), static_cast<std::streamsize>(end));
+  output.put(',');
+  repeatWord(fillWords, initValue);
+  startChunk();
+}
+
+void SerialReader::ReadoutExpander::put(const uint8_t byte) {
+  if (encoding == Encoding::SPARSE) {
+    putSparse(byte);
+  } else {
+    putRle(byte);
+  }
+  if (++chunkPos == CHUNK_SIZE) {
+    chunkPos = 0;
+    startChunk();
+  }
+}
+
+void SerialReader::ReadoutExpander::startChunk() {
+  base = 0;
+  varint = 0;
+  shift = 0;
+  value = 0;
+  valueBytes = 0;
+  literal = 0;
+  state = encoding == Encoding::SPARSE ? State::DELTA : State::FIRST_CELL;
+}
+
+void SerialReader::ReadoutExpander::putSparse(const uint8_t byte) {
+  switch (state) {
+  case State::DELTA:
+    if (shift == 0 && byte == 0) {
+      state = State::PADDING;
+    } else if (shift > 28) {
+      // Longer than any cell number, the rest of this chunk can't be trusted
+      state = State::PADDING;
+    } else {
+      varint |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        state = State::VALUE;
+      }
+    }
+    break;
+  case State::VALUE:
+    value = value << 8 | byte;
+    if (++valueBytes == 4) {
+      const uint32_t cell = base + varint - 1;
+      if (cell >= next) {
+        words(cell, initValue ^ value, 1);
+        ++changed;
+      }
+      base = cell + 1;
+      varint = 0;
+      shift = 0;
+      value = 0;
+      valueBytes = 0;
+      state = State::DELTA;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void SerialReader::ReadoutExpander::putRle(const uint8_t byte) {
+  switch (state) {
+  case State::FIRST_CELL:
+    value = value << 8 | byte;
+    if (++valueBytes == 4) {
+      base = value;
+      value = 0;
+      valueBytes = 0;
+      // A chunk filled with zeros starts at cell 0 again and has nothing but padding after it
+      state = base < next ? State::PADDING : State::TOKEN;
+    }
+    break;
+  case State::TOKEN:
+    if (byte >= 1 && byte <= 127) {
+      literal = byte;
+      state = State::LITERAL;
+    } else if (byte == 0x80) {
+      state = State::RUN_COUNT;
+    } else {
+      state = State::PADDING;
+    }
+    break;
+  case State::LITERAL:
+    value = value << 8 | byte;
+    if (++valueBytes == 4) {
+      words(base++, value, 1);
+      value = 0;
+      valueBytes = 0;
+      if (--literal == 0) {
+        state = State::TOKEN;
+      }
+    }
+    break;
+  case State::RUN_COUNT:
+    if (shift > 28) {
+      state = State::PADDING;
+      break;
+    }
+    varint |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) {
+      state = State::RUN_WORD;
+    }
+    break;
+  case State::RUN_WORD:
+    value = value << 8 | byte;
+    if (++valueBytes == 4) {
+      words(base, value, varint);
+      base += varint;
+      varint = 0;
+      shift = 0;
+      value = 0;
+      valueBytes = 0;
+      state = State::TOKEN;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void SerialReader::ReadoutExpander::words(const uint32_t cell, const uint32_t value, uint32_t count) {
+  if (cell < next || cell >= total) {
+    return;
+  }
+  count = std::min(count, total - cell);
+  fill(cell);
+  if (count == 1) {
+    const char bytes[4] = {
+      static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+      static_cast<char>(value >> 8), static_cast<char>(value)
+    };
+    output.write(bytes, 4);
+  } else {
+    repeatWord(runWords, value);
+    for (uint32_t written = 0; written < count;) {
+      const uint32_t n = std::min(count - written, FILL_WORDS);
+      output.write(runWords.data(), n * 4);
+      written += n;
+    }
+  }
+  next = cell + count;
+}
+
+void SerialReader::ReadoutExpander::fill(const uint32_t cell) {
+  while (next < cell) {
+    const uint32_t n = std::min(cell - next, FILL_WORDS);
+    output.write(fillWords.data(), n * 4);
+    next += n;
+  }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace SerialReader {
+  /**
+   * Stream buffer between the ChunkDecoder and the output which expands encoded readouts to the same file a full
+   * memory dump would give. Both encodings keep every chunk decodable on its own, a chunk filled with zeros by the
+   * ChunkDecoder only loses the cells it carried.
+   *
+   * Sparse readouts (firmware mode 5, see puf_encode_sparse in getpuf/GetPuf.c) have the header
+   * "<bank><row><col>:<init value>:<cells>," (hex) and consist of records of
+   *   cell delta (LEB128 varint) | cell ^ init value (4, big endian)
+   * Within a chunk the first delta is the cell number + 1, later ones count from the previous record. A 0 byte in
+   * place of a delta fills up the rest of the chunk. Cells without a record hold the init value.
+   *
+   * Compressed readouts (firmware mode 6, see puf_encode_rle) have the header "<bank><row><col>;<cells>," (hex).
+   * Every chunk starts with the number of its first cell (4, big endian), followed by tokens of
+   *   n (1 - 127) | n words            literal
+   *   0x80 | count (LEB128 varint) | word   run of count equal words
+   * where a 0 byte fills up the rest of the chunk. Cells of lost chunks are zeros, like in a full memory dump.
+   *
+   * Dense readouts, and encoded ones if keepEncoded is set, are passed through unchanged.
+   */
+  class ReadoutExpander : public std::streambuf {
+  public:
+    ReadoutExpander(std::ostream& output, bool keepEncoded) : output(output), keepEncoded(keepEncoded) {}
+
+    /**
+     * Writes the cells after the last record or token.
+     */
+    void finish();
+
+    [[nodiscard]] bool isSparse() const {
+      return encoding == Encoding::SPARSE;
+    }
+
+    [[nodiscard]] bool isCompressed() const {
+      return encoding == Encoding::RLE;
+    }
+
+    /**
+     * Cells which differ from the init value, of sparse readouts.
+     */
+    [[nodiscard]] uint32_t changedCells() const {
+      return changed;
+    }
+
+    [[nodiscard]] uint32_t cells() const {
+      return total;
+    }
+
+  protected:
+    int_type overflow(int_type ch) override;
+
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+  private:
+    enum class Encoding {
+      DENSE,
+      SPARSE,
+      RLE
+    };
+
+    enum class State {
+      HEADER,
+      PASS,
+      FIRST_CELL,
+      DELTA,
+      VALUE,
+      TOKEN,
+      LITERAL,
+      RUN_COUNT,
+      RUN_WORD,
+      PADDING
+    };
+
+    void header();
+
+    void put(uint8_t byte);
+
+    void putSparse(uint8_t byte);
+
+    void putRle(uint8_t byte);
+
+    void startChunk();
+
+    void words(uint32_t cell, uint32_t value, uint32_t count);
+
+    void fill(uint32_t cell);
+
+    std::ostream& output;
+    const bool keepEncoded;
+    Encoding encoding = Encoding::DENSE;
+    State state = State::HEADER;
+    std::string head;
+    // Unchanged cells, init values for sparse readouts and zeros for lost chunks of compressed ones
+    std::string fillWords;
+    std::string runWords;
+    uint32_t initValue = 0;
+    uint32_t total = 0;
+    uint32_t changed = 0;
+    // Position in the current chunk, the cell the next delta counts from or the next token starts at, and the next
+    // cell to write
+    size_t chunkPos = 0;
+    uint32_t base = 0;
+    uint32_t next = 0;
+    // Varint being read and the bytes of the word being read
+    uint32_t varint = 0;
+    int shift = 0;
+    uint32_t value = 0;
+    int valueBytes = 0;
+    // Words left in a literal
+    uint32_t literal = 0;
+  };
+}
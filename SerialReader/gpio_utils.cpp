@@ -7,10 +7,11 @@
 
 /* Everything here copied from WiringPi */
 
-int SerialReader::uartOpen(const char* port, const int baud) {
+int SerialReader::uartOpen(const char* port, const int baud, const bool flowControl) {
   termios options{};
   speed_t myBaud;
   int status, fd;
+  bool custom = false;
 
   switch (baud) {
   case 50:
@@ -105,7 +106,10 @@ int SerialReader::uartOpen(const char* port, const int baud) {
     break;
 
   default:
-    return -2;
+    // Set through termios2 once the port is configured
+    myBaud = B115200;
+    custom = true;
+    break;
   }
 
   if ((fd = open(port, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK)) == -1)
@@ -126,6 +130,11 @@ int SerialReader::uartOpen(const char* port, const int baud) {
   options.c_cflag &= ~CSTOPB;
   options.c_cflag &= ~CSIZE;
   options.c_cflag |= CS8;
+  if (flowControl) {
+    options.c_cflag |= CRTSCTS;
+  } else {
+    options.c_cflag &= ~CRTSCTS;
+  }
   options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
   options.c_oflag &= ~OPOST;
 
@@ -143,6 +152,11 @@ int SerialReader::uartOpen(const char* port, const int baud) {
 
   usleep(10000); // 10mS
 
+  if (custom && !uartSetBaud(fd, baud)) {
+    close(fd);
+    return -2;
+  }
+
   return fd;
 }
 
@@ -150,6 +164,20 @@ void SerialReader::serialPuts(const int fd, const char* s) {
   write(fd, s, strlen(s));
 }
 
+void SerialReader::serialWrite(const int fd, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t written = write(fd, data.data(), data.size());
+    if (written <= 0) {
+      return;
+    }
+    data.remove_prefix(written);
+  }
+}
+
 void SerialReader::serialFlush(const int fd) {
   tcflush(fd, TCIOFLUSH);
 }
+
+void SerialReader::serialDrain(const int fd) {
+  tcdrain(fd);
+}
@@ -1,9 +1,35 @@
 #pragma once
 
+// Rate both ends start with, until another one has been negotiated
+#define DEFAULT_BAUD 115200
+
+#include <string_view>
+
 namespace SerialReader {
-  int uartOpen(const char* port, int baud);
+  /**
+   * With flowControl, the sender is only allowed to transmit while RTS is asserted (CRTSCTS).
+   */
+  int uartOpen(const char* port, int baud, bool flowControl = false);
+
+  /**
+   * Switches an open port to any baud rate the driver can generate, not only the ones with a Bxxx constant.
+   */
+  bool uartSetBaud(int fd, int baud);
 
   void serialPuts(int fd, const char* s);
 
+  /**
+   * Writes binary data, which may contain zeros.
+   */
+  void serialWrite(int fd, std::string_view data);
+
+  /**
+   * Discards everything received but not read and everything written but not sent yet.
+   */
   void serialFlush(int fd);
+
+  /**
+   * Waits until everything written is sent. Unlike serialFlush, nothing received (like the next prompt) is lost.
+   */
+  void serialDrain(int fd);
 }
@@ -0,0 +1,38 @@
+#include <ostream>
+#include <sstream>
+#include <string>
+#include "jobs.h"
+#include "runner.h"
+#include "writer.h"
+
+void SerialReader::runJobs(Parser& parser) {
+  Runner runner(parser.getSerialPort().c_str(), parser.getGpioChip().c_str(),
+                parser.getUSBPort(), parser.getBaudRate(), parser.getFlowControl());
+  const std::vector<Job>& jobs = parser.getJobs();
+  bool running = true;
+  bool booted = false;
+  int count = 0;
+  for (size_t i = 0; running && i < jobs.size();) {
+    const Job& job = jobs[i];
+    const std::string path = parser.getOutPrefix() + std::to_string(count) + ".bin";
+    std::ostringstream oss;
+    oss << "Job " << i + 1 << "/" << jobs.size() << " into " << path << ":";
+    for (const std::string& param : job.params) {
+      oss << " " << param;
+    }
+    runner.logData(oss.str());
+    AsyncWriter writer(path);
+    std::ostream pufOutput(&writer);
+    const bool boot = !booted || job.boot;
+    if (boot) {
+      runner.reset(parser);
+    }
+    const int before = count;
+    running = runner.loop(parser, job.params, !boot, pufOutput, count);
+    booted = count > before;
+    if (booted) {
+      ++i;
+    }
+  }
+  runner.release();
+}
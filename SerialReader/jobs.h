@@ -0,0 +1,12 @@
+#pragma once
+
+#include "parser.h"
+
+namespace SerialReader {
+  /**
+   * Runs the jobs given with --jobs in order on one board, each into its own file. The kernel offers its menu again
+   * once the firmware has read out a job, so the board is only power cycled before the first job, before jobs marked
+   * "boot" and to repeat a job which didn't end (panic or lost connection).
+   */
+  void runJobs(Parser& parser);
+}
@@ -1,6 +1,8 @@
 #include <args.hxx>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include "parser.h"
 
 static std::unique_ptr<SerialReader::Parser> parser;
@@ -14,7 +16,9 @@ int SerialReader::init(const int argc, const char** argv) {
                                            "/dev/ttyS0");
   args::ValueFlag<std::string> gpioChipA(argsParser, "chip", "The GPIO chip to use", {'g', "gpio"},
                                          "gpiochip0");
-  args::ValueFlag baudA(argsParser, "baud", "Baud Rate to use", {'b', "baud"}, 115200);
+  args::ValueFlag baudA(argsParser, "baud",
+                        "Baud rate to negotiate with the kernel once it has booted, falls back to 115200",
+                        {'b', "baud"}, 115200);
   args::ValueFlag usbPortA(argsParser, "relais", "The USB bus to use", {'r', "relais"}, 2);
   args::ValueFlag usbSleepA(argsParser, "sleep", "Sleep time of the USB Bus between the measurements",
                             {'t', "sleep"}, 5);
@@ -22,6 +26,31 @@ int SerialReader::init(const int argc, const char** argv) {
   args::ValueFlag<std::string> outA(argsParser, "out", "File output prefix", {'o', "out"}, "out");
   args::ValueFlagList<std::string> paramsA(argsParser, "params", "The params to send to the RaspPi", {'p', "params"},
                                            std::vector<std::string>(1, "4"));
+  args::ValueFlagList<std::string> boardsA(argsParser, "board",
+                                           "Capture several sender Pis at once, given as serial port:relais:out prefix. "
+                                           "Replaces -s, -r and -o", {'B', "board"});
+  args::ValueFlag paramDelayA(argsParser, "delay",
+                              "Milliseconds to wait after each prompt before sending a parameter, and at most for "
+                              "its echo before confirming it", {'d', "delay"}, DEFAULT_PARAM_DELAY);
+  args::Flag flowControlA(argsParser, "flow", "Use RTS/CTS hardware flow control (GPIO 16/17 on the sender)",
+                          {'f', "flow"});
+  args::Flag keepEncodedA(argsParser, "keep", "Keep sparse and compressed readouts (modes 5 and 6) as received "
+                          "instead of expanding them to a full memory dump", {'k', "keep"});
+  args::ValueFlag<std::string> positionsA(argsParser, "positions",
+                                          "stable.pos file with the bit positions to read in the stable bits mode "
+                                          "(mode 7)", {'P', "positions"});
+  args::ValueFlag<std::string> scheduleA(argsParser, "schedule",
+                                         "Sub-ranges and the seconds after which they are read in the staggered "
+                                         "readout (mode 8), e.g. C3000000-C3100000@10,C3100000-C3200000@30",
+                                         {'S', "schedule"});
+  args::ValueFlag<std::string> probesA(argsParser, "probes",
+                                        "Probe rows outside of the range and the flip rate in ppm at which the "
+                                        "adaptive decay (mode 10) stops, e.g. C3F00000-C3F10000@500",
+                                        {'A', "probes"});
+  args::ValueFlag<std::string> jobsA(argsParser, "jobs",
+                                     "File with one job per line (its params), run back to back without power "
+                                     "cycles in between, each written to its own file. Replaces -p",
+                                     {'J', "jobs"});
   args::CompletionFlag completion(argsParser, {"complete"});
 
   try {
@@ -38,13 +67,77 @@ int SerialReader::init(const int argc, const char** argv) {
     return 1;
   }
 
+  std::vector<Board> boards;
+  for (const auto& description : args::get(boardsA)) {
+    if (Board board; parseBoard(description, board)) {
+      boards.push_back(board);
+    } else {
+      std::cerr << "Invalid board \"" << description << "\", expected serial port:relais:out prefix" << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Job> jobs;
+  if (jobsA && (!loadJobs(args::get(jobsA), jobs) || jobs.empty())) {
+    std::cerr << "Can't read jobs from \"" << args::get(jobsA) << "\"" << std::endl;
+    return 1;
+  }
+
   parser = std::make_unique<Parser>(args::get(serialPortA), args::get(gpioChipA), get(baudA),
                                     get(usbPortA), get(usbSleepA), get(maxMeasuresA),
-                                    true, args::get(outA), args::get(paramsA));
+                                    true, args::get(outA), args::get(paramsA), boards,
+                                    get(paramDelayA), args::get(flowControlA), args::get(keepEncodedA),
+                                    args::get(positionsA), args::get(scheduleA), jobs,
+                                    args::get(probesA));
 
   return 2;
 }
 
+bool SerialReader::parseBoard(const std::string& description, Board& board) {
+  const size_t first = description.find(':');
+  const size_t second = first == std::string::npos ? first : description.find(':', first + 1);
+  if (second == std::string::npos || first == 0 || second == description.size() - 1) {
+    return false;
+  }
+  try {
+    size_t end;
+    board.usbPort = std::stoi(description.substr(first + 1, second - first - 1), &end);
+    if (end != second - first - 1) return false;
+  } catch (const std::exception&) {
+    return false;
+  }
+  board.serialPort = description.substr(0, first);
+  board.outPrefix = description.substr(second + 1);
+  return true;
+}
+
+bool SerialReader::loadJobs(const std::string& path, std::vector<Job>& jobs) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  jobs.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream iss(line.substr(0, line.find('#')));
+    Job job;
+    std::string param;
+    while (iss >> param) {
+      if (job.params.empty() && !job.boot && param == "boot") {
+        job.boot = true;
+      } else {
+        job.params.push_back(param);
+      }
+    }
+    if (job.params.empty()) {
+      if (job.boot) return false;
+      continue;
+    }
+    jobs.push_back(std::move(job));
+  }
+  return true;
+}
+
 SerialReader::Parser& SerialReader::getParser() {
   return *parser;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#define DEFAULT_PARAM_DELAY 50
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -7,14 +9,48 @@
 namespace SerialReader {
   int init(int argc, const char** argv);
 
+  /**
+   * One sender Pi of a multi-board bench: its serial port, the relay line powering it and its dump file prefix.
+   */
+  struct Board {
+    std::string serialPort;
+    int usbPort;
+    std::string outPrefix;
+  };
+
+  /**
+   * Parses "port:relay:prefix", returns false if the description is malformed.
+   */
+  bool parseBoard(const std::string& description, Board& board);
+
+  /**
+   * One job of a batch: the params sent to the kernel menu, and whether the sender has to be power cycled first.
+   */
+  struct Job {
+    std::vector<std::string> params;
+    bool boot = false;
+  };
+
+  /**
+   * Reads a job file, one job per line given as its whitespace separated params. A line starting with "boot" is only
+   * run after a power cycle, "#" starts a comment. Returns false if the file can't be read or a line has no params.
+   */
+  bool loadJobs(const std::string& path, std::vector<Job>& jobs);
+
   struct Parser {
     Parser(std::string _serialPort, std::string _gpioChip, const int _baudRate,
            const int rpi_power_port, const int _usbSleep, const int _maxMeasures, bool&& _fileOut,
-           std::string _outPrefix, const std::vector<std::string>& _params)
+           std::string _outPrefix, const std::vector<std::string>& _params,
+           const std::vector<Board>& _boards = {}, const int _paramDelay = DEFAULT_PARAM_DELAY,
+           const bool _flowControl = false, const bool _keepEncoded = false, std::string _positionsFile = "",
+           std::string _schedule = "", const std::vector<Job>& _jobs = {}, std::string _probes = "")
       : serialPort(std::move(_serialPort)), gpioChip(std::move(_gpioChip)),
         baudRate(_baudRate), usbPort(rpi_power_port), usbSleep(_usbSleep),
         maxMeasures(_maxMeasures), fileOut(_fileOut),
-        outPrefix(std::move(_outPrefix)), params(_params) {};
+        outPrefix(std::move(_outPrefix)), params(_params), boards(_boards),
+        paramDelay(_paramDelay), flowControl(_flowControl), keepEncoded(_keepEncoded),
+        positionsFile(std::move(_positionsFile)), schedule(std::move(_schedule)), jobs(_jobs),
+        probes(std::move(_probes)) {};
 
     [[nodiscard]] const std::string& getSerialPort() const {
       return serialPort;
@@ -52,6 +88,57 @@ namespace SerialReader {
       return params;
     }
 
+    [[nodiscard]] const std::vector<Board>& getBoards() const {
+      return boards;
+    }
+
+    /**
+     * Milliseconds to wait after a prompt before sending the parameter, and at most for its echo afterwards.
+     */
+    [[nodiscard]] int getParamDelay() const {
+      return paramDelay;
+    }
+
+    [[nodiscard]] bool getFlowControl() const {
+      return flowControl;
+    }
+
+    /**
+     * Write sparse and compressed readouts (modes 5 and 6) as received instead of expanding them to a full memory
+     * dump.
+     */
+    [[nodiscard]] bool getKeepEncoded() const {
+      return keepEncoded;
+    }
+
+    /**
+     * The stable.pos file uploaded for the stable bits mode (mode 7).
+     */
+    [[nodiscard]] const std::string& getPositionsFile() const {
+      return positionsFile;
+    }
+
+    /**
+     * Sub-ranges and their read times for the staggered readout (mode 8), as "start-end@seconds,...".
+     */
+    [[nodiscard]] const std::string& getSchedule() const {
+      return schedule;
+    }
+
+    /**
+     * Probe rows and the target flip rate of the adaptive decay (mode 10), as "start-end@ppm".
+     */
+    [[nodiscard]] const std::string& getProbes() const {
+      return probes;
+    }
+
+    /**
+     * Jobs run back to back within one boot instead of the params, each written to its own file.
+     */
+    [[nodiscard]] const std::vector<Job>& getJobs() const {
+      return jobs;
+    }
+
   private:
     const std::string serialPort;
     const std::string gpioChip;
@@ -62,6 +149,14 @@ namespace SerialReader {
     const bool fileOut;
     const std::string outPrefix;
     const std::vector<std::string> params;
+    const std::vector<Board> boards;
+    const int paramDelay;
+    const bool flowControl;
+    const bool keepEncoded;
+    const std::string positionsFile;
+    const std::string schedule;
+    const std::vector<Job> jobs;
+    const std::string probes;
   };
 
   Parser& getParser();
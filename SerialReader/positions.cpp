@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <fstream>
+#include "chunk.h"
+#include "positions.h"
+
+bool SerialReader::loadPositions(const std::string& path, std::vector<uint32_t>& positions) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  positions.clear();
+  int64_t position;
+  while (file >> position) {
+    if (position < 0 || position > UINT32_MAX) {
+      return false;
+    }
+    positions.push_back(static_cast<uint32_t>(position));
+  }
+  if (!file.eof()) {
+    return false;
+  }
+  std::sort(positions.begin(), positions.end());
+  positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+  return true;
+}
+
+std::string SerialReader::encodePositions(const std::vector<uint32_t>& positions) {
+  std::string encoded;
+  uint32_t previous = 0;
+  for (const uint32_t position : positions) {
+    uint32_t delta = position - previous;
+    while (delta >= 0x80) {
+      encoded += static_cast<char>((delta & 0x7F) | 0x80);
+      delta >>= 7;
+    }
+    encoded += static_cast<char>(delta);
+    previous = position;
+  }
+  return encoded;
+}
+
+std::string SerialReader::positionsHeader(const std::string& encoded) {
+  return std::to_string(encoded.size()) + " " + std::to_string(crc32(encoded));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SerialReader {
+  /**
+   * Reads the bit positions of a stable.pos file (whitespace separated, counting the bits of a memory dump after
+   * the header, most significant bit of every byte first) in ascending order without duplicates.
+   * Returns false if the file can't be read or holds anything but positions.
+   */
+  bool loadPositions(const std::string& path, std::vector<uint32_t>& positions);
+
+  /**
+   * Encodes ascending positions for the stable bits mode (mode 7, see puf_receive_positions in getpuf/GetPuf.c) as
+   * LEB128 varints of the distance to the previous position, the first one counted from 0.
+   */
+  std::string encodePositions(const std::vector<uint32_t>& positions);
+
+  /**
+   * The answer to the firmware's "Positions" prompt: "<bytes> <CRC32>" of the encoded positions, which follow right
+   * after the carriage return.
+   */
+  std::string positionsHeader(const std::string& encoded);
+}
@@ -1,20 +1,63 @@
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include "boards.h"
+#include "eventloop.h"
 #include "gpio_utils.h"
+#include "jobs.h"
 #include "logger.h"
 #include "parser.h"
+#include "positions.h"
 #include "runner.h"
+#include "scanner.h"
+#include "writer.h"
+
+/**
+ * Replaces everything the terminal can't show with a space, like the live log always did.
+ */
+static std::string printable(const std::string_view text) {
+  std::string result(text);
+  for (char& c : result) {
+    if ((c < 32 || c > 126) && c != 10 && c != 13) {
+      c = ' ';
+    }
+  }
+  return result;
+}
+
+static std::string writerStats(const SerialReader::WriterStats& stats) {
+  std::ostringstream oss;
+  oss << "Disk writer: " << stats.buffersWritten << " buffers, max. ring occupancy " << stats.maxOccupancy << "/"
+      << WRITER_RING_SIZE << ", stalled " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.stallTime).count()
+      << " ms, writing took " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.writeTime).count() << " ms";
+  if (stats.error != 0) {
+    oss << ", write error: " << std::strerror(stats.error);
+  }
+  return oss.str();
+}
 
 void SerialReader::run(Parser& parser) {
+  if (!parser.getBoards().empty()) {
+    runBoards(parser);
+    return;
+  }
+  if (!parser.getJobs().empty()) {
+    runJobs(parser);
+    return;
+  }
   Runner runner(parser.getSerialPort().c_str(), parser.getGpioChip().c_str(),
-                parser.getUSBPort(), parser.getBaudRate());
+                parser.getUSBPort(), parser.getBaudRate(), parser.getFlowControl());
   bool running = true;
   int count = 0;
   while (running) {
-    std::ofstream pufOutput(parser.getOutPrefix() + std::to_string(count) + ".bin");
+    AsyncWriter writer(parser.getOutPrefix() + std::to_string(count) + ".bin");
+    std::ostream pufOutput(&writer);
     runner.reset(parser);
     running = runner.loop(parser, pufOutput, count);
   }
@@ -33,11 +76,24 @@ char* gen_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_
   params.reserve(params_size);
   for (int i = 0; i < params_size; i++)
     params.emplace_back(_params[i]);
+  // In the stable bits mode only the bits at the positions are read out, in their order
+  const bool stableBits = !params.empty() && params[0] == "7";
   auto parser = SerialReader::Parser(serialPort, gpioChip, baud, rpi_power_port,
-                                     sleep, 1, true, outName, params);
+                                     sleep, 1, true, outName, params, {}, DEFAULT_PARAM_DELAY, false, false,
+                                     stableBits ? _pos_file : "");
   std::ostringstream out;
   run(parser, out);
   std::string out_str = out.str();
+  if (stableBits) {
+    auto result = new char[key_size];
+    const size_t comma = out_str.find(',');
+    const std::string_view bits = comma == std::string::npos ? "" : std::string_view(out_str).substr(comma + 1);
+    for (int i = 0; i < key_size; i++) {
+      const size_t byte = i / 8;
+      result[i] = static_cast<char>((byte < bits.size() ? bits[byte] >> (7 - i % 8) & 1 : 0) + '0');
+    }
+    return result;
+  }
   const char* in = out_str.c_str();
   std::ifstream pos_file(_pos_file);
   auto result = new char[key_size];
@@ -72,7 +128,7 @@ char* gen_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_
 
 void SerialReader::run(Parser& parser, std::ostream& output) {
   Runner runner(parser.getSerialPort().c_str(), parser.getGpioChip().c_str(),
-                parser.getUSBPort(), parser.getBaudRate());
+                parser.getUSBPort(), parser.getBaudRate(), parser.getFlowControl());
   bool running = true;
   int count = 0;
   while (running && count == 0) {
@@ -83,144 +139,583 @@ void SerialReader::run(Parser& parser, std::ostream& output) {
 }
 
 SerialReader::Runner::Runner(const char* port, const char* chipName,
-                             const int usb, const int baud)
-  : fd(uartOpen(port, baud)),
+                             const int usb, const int baud, const bool flowControl, std::string name,
+                             std::shared_ptr<std::ostream> log)
+  : fd(uartOpen(port, DEFAULT_BAUD, flowControl)),
     gpioChip(gpiod::chip(chipName)),
-    gpioRelayLine(gpioChip.get_line(usb)) {
+    gpioRelayLine(gpioChip.get_line(usb)),
+    name(std::move(name)),
+    targetBaud(baud),
+    log(log ? std::move(log) : openLog()) {
   gpioRelayLine.request({"SerialReader", gpiod::line_request::DIRECTION_OUTPUT, 0});
+}
+
+std::shared_ptr<std::ostream> SerialReader::Runner::openLog() {
 #ifdef LOG
     auto t = std::time(nullptr);
     auto tm = *std::localtime(&t);
     std::ostringstream oss;
     oss << std::put_time(&tm, "%Y%m%d_%H%M%S");
-    log = std::ofstream(oss.str() + ".log");
+    return std::make_shared<std::ofstream>(oss.str() + ".log");
 #else
-  log = std::ofstream();
+  return std::make_shared<std::ofstream>();
 #endif
 }
 
 void SerialReader::Runner::reset(const Parser& parser) {
-  log_data("Cutting off USB Power...", log);
-  gpioRelayLine.set_value(1);
+  powerOff();
   std::this_thread::sleep_for(std::chrono::seconds(parser.getUSBSleepTime()));
-  log_data("Turning on USB Power...", log);
+  powerOn();
+}
+
+void SerialReader::Runner::powerOff() {
+  logData("Cutting off USB Power...");
+  gpioRelayLine.set_value(1);
+}
+
+void SerialReader::Runner::powerOn() {
+  logData("Turning on USB Power...");
+  // Whatever is left from the last run is stale once the board boots again
+  serialFlush(fd);
   gpioRelayLine.set_value(0);
 }
 
+void SerialReader::Runner::logData(const std::string& data) {
+  if (name.empty()) {
+    log_data(data, *log);
+    return;
+  }
+  if (!liveLine.empty()) {
+    logLive("\n");
+  }
+  log_live("[" + name + "] " + data + "\n", *log);
+}
+
+void SerialReader::Runner::logLive(const std::string_view text) {
+  if (name.empty()) {
+    log_live(printable(text), *log);
+    return;
+  }
+  // Several boards share the terminal, so only whole lines are written
+  for (const char c : printable(text)) {
+    if (c == '\n') {
+      log_live("[" + name + "] " + liveLine + "\n", *log);
+      liveLine.clear();
+    } else if (c != '\r') {
+      liveLine += c;
+    }
+  }
+}
+
 bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count) {
+  return loop(parser, parser.getParams(), false, output, count);
+}
+
+bool SerialReader::Runner::loop(Parser& parser, const std::vector<std::string>& params, const bool booted,
+                                std::ostream& output, int& count) {
+  EventLoop events;
   bool running = true;
-  //log_data("Starting measurement...", log);
-  char lastChar = ' ', in = ' ';
-  size_t numBytes = 0, i = 0;
-  char readBuf[BUFFER_SIZE];
-  bool writePuf = false;
-  volatile bool interrupt = false;
-  int charCount = 0;
-  std::thread* input = nullptr;
+  start(events, parser, params, booted, output, count, [&events, &running](const bool result) {
+    running = result;
+    events.stop();
+  });
 #ifdef USER_INPUT
-    std::thread inputUser([this, &interrupt] {
-        while (!interrupt) {
-            std::string str;
-            std::cin >> str;
-            if (str == ".") {
-                serialPutchar(fd, '\r');
-            } else {
-                str += "\r";
-                serialPuts(fd, str.c_str());
-            }
-            serialFlush(fd);
-        }
-    });
+  std::string userInput;
+  events.watch(STDIN_FILENO, [this, &events, &userInput](uint32_t) {
+    char inputBuf[256];
+    const ssize_t numBytes = read(STDIN_FILENO, inputBuf, sizeof(inputBuf));
+    if (numBytes <= 0) {
+      events.unwatch(STDIN_FILENO);
+      return;
+    }
+    userInput.append(inputBuf, numBytes);
+    size_t end;
+    while ((end = userInput.find_first_of(" \t\n")) != std::string::npos) {
+      std::string str = userInput.substr(0, end);
+      userInput.erase(0, end + 1);
+      if (str.empty()) continue;
+      if (str == ".") str.clear();
+      str += "\r";
+      serialPuts(fd, str.c_str());
+      serialDrain(fd);
+    }
+  });
 #endif
-  while (!interrupt) {
-    if (i >= numBytes) {
-      i = 0;
-      numBytes = read(fd, &readBuf, BUFFER_SIZE);
-      if (numBytes <= 0) continue;
-    }
-    in = readBuf[i];
-    ++i;
-
-    if (!writePuf) {
-      if ((in < 32 || in > 126) && in != 10 && in != 13) {
-        log_live(" ", log);
-      } else {
-        log_live(in, log);
-      }
+  events.run();
+  if (!events.getError().empty()) {
+    logData("Event loop failed, " + events.getError() + ".");
+    running = false;
+  }
+  std::cout << std::endl;
+  return running;
+}
+
+void SerialReader::Runner::start(EventLoop& events, Parser& parser, std::ostream& output, int& count,
+                                 std::function<void(bool)> done) {
+  start(events, parser, parser.getParams(), false, output, count, std::move(done));
+}
+
+void SerialReader::Runner::start(EventLoop& events, Parser& parser, const std::vector<std::string>& params,
+                                 const bool booted, std::ostream& output, int& count,
+                                 std::function<void(bool)> done) {
+  //log_data("Starting measurement...", log);
+  measurement = std::make_unique<Measurement>(parser, params, output, count, events, std::move(done));
+  ++handshakeStep;
+  if (!booted) {
+    // The board boots at the default rate again
+    pending.clear();
+    switchBaud(DEFAULT_BAUD);
+  } else if (!pending.empty()) {
+    // The kernel may already have shown the menu for this job, in the same read as the end of the last one
+    const std::string received = std::move(pending);
+    pending.clear();
+    process(received);
+    if (measurement->finished) {
+      events.schedule(std::chrono::milliseconds(0), [this] { complete(); });
+      return;
     }
-    if (START_1 == lastChar && START_2 == in) {
-      writePuf = true;
-      if (input != nullptr) {
-        input->join();
-        delete input;
-        input = nullptr;
-      }
-    } else if (END_1 == lastChar && END_2 == in) {
-      ++count;
-      writePuf = false;
-      log_data(std::to_string(charCount) + " bytes in total written.", log);
-      output.flush();
-      if (auto* o = dynamic_cast<std::ofstream*>(&output)) {
-        o->close();
+  }
+  events.watch(fd, [this](const uint32_t ready) { receive(ready); });
+}
+
+void SerialReader::Runner::handshakeTimer(const std::chrono::milliseconds delay, std::function<void()> callback) {
+  // A later step of the handshake or the end of the measurement makes the timer obsolete
+  const unsigned step = ++handshakeStep;
+  measurement->events.schedule(delay, [this, step, callback = std::move(callback)] {
+    if (measurement && handshakeStep == step) callback();
+  });
+}
+
+void SerialReader::Runner::prompted() {
+  Measurement& m = *measurement;
+  if (m.handshake != Handshake::READY) {
+    return;
+  }
+  if (m.line.find("Baud rate") != std::string::npos) {
+    m.answer = std::to_string(targetBaud);
+  } else if (m.line.find("Baud check") != std::string::npos) {
+    m.answer.clear();
+  } else if (m.line.find("Positions") != std::string::npos) {
+    m.answer = positionsAnswer();
+    m.uploading = !m.answer.empty();
+  } else if (m.line.find("Schedule") != std::string::npos) {
+    m.answer = m.parser.getSchedule();
+  } else if (m.line.find("Probes") != std::string::npos) {
+    m.answer = m.parser.getProbes();
+  } else if (m.line.find("Resend chunks") != std::string::npos) {
+    m.answer = nextResend();
+    m.resuming = !m.answer.empty();
+  } else if (m.nextParam == 0 && !m.commandSent && m.params.size() == COMMAND_FIELDS &&
+             m.line.find(COMMAND_PROMPT) != std::string::npos) {
+    m.commandSent = true;
+    m.answer = "!";
+    for (size_t i = 0; i < m.params.size(); i++) {
+      m.answer += (i == 0 ? "" : " ") + m.params[i];
+    }
+  } else if (m.nextParam < m.params.size()) {
+    m.answer = m.params[m.nextParam++];
+  } else {
+    return;
+  }
+  m.handshake = Handshake::PROMPTED;
+  handshakeTimer(std::chrono::milliseconds(m.parser.getParamDelay()), [this] { sendParam(); });
+}
+
+void SerialReader::Runner::sendParam() {
+  Measurement& m = *measurement;
+  if (m.answer.empty()) {
+    confirmParam();
+    return;
+  }
+  serialPuts(fd, m.answer.c_str());
+  serialDrain(fd);
+  m.handshake = Handshake::ECHO;
+  m.echo.clear();
+  handshakeTimer(std::chrono::milliseconds(m.parser.getParamDelay()), [this] { confirmParam(); });
+}
+
+void SerialReader::Runner::confirmParam() {
+  Measurement& m = *measurement;
+  ++handshakeStep;
+  m.handshake = Handshake::READY;
+  serialPuts(fd, "\r");
+  if (m.uploading) {
+    m.uploading = false;
+    serialWrite(fd, positions);
+  }
+  serialDrain(fd);
+  if (m.resuming) {
+    // Everything from here on is the requested chunks, up to the next end chunk
+    m.resuming = false;
+    m.decoder->resume();
+  }
+}
+
+std::string SerialReader::Runner::nextResend() {
+  Measurement& m = *measurement;
+  if (!m.decoder) {
+    return "";
+  }
+  const std::vector<uint32_t> missing = m.decoder->missing();
+  auto first = std::lower_bound(missing.begin(), missing.end(), m.resendFrom);
+  if (first == missing.end()) {
+    // Another round over everything still missing
+    if (missing.empty() || ++m.resendRound >= MAX_RESEND_ROUNDS) {
+      return "";
+    }
+    first = missing.begin();
+  }
+  uint32_t count = 1;
+  while (first + count != missing.end() && count < RESEND_BATCH && *(first + count) == *first + count) {
+    ++count;
+  }
+  m.resendFrom = *first + count;
+  return std::to_string(*first) + " " + std::to_string(count);
+}
+
+std::string SerialReader::Runner::positionsAnswer() {
+  if (positions.empty()) {
+    const std::string& path = measurement->parser.getPositionsFile();
+    std::vector<uint32_t> list;
+    if (path.empty()) {
+      logData("The firmware asks for bit positions, but no positions file was given.");
+      return "";
+    }
+    if (!loadPositions(path, list) || list.empty()) {
+      logData("Can't read bit positions from " + path + ".");
+      return "";
+    }
+    positions = encodePositions(list);
+    logData(std::to_string(list.size()) + " bit positions in " + std::to_string(positions.size()) + " bytes.");
+  }
+  return positionsHeader(positions);
+}
+
+void SerialReader::Runner::textLine(const std::string& line) {
+  if (line.rfind(PHASES_PREFIX, 0) == 0) {
+    phasesLine(line);
+    return;
+  }
+  // The kernel announces every baud rate switch as "Baud <rate>" right before it happens
+  if (line.rfind("Baud ", 0) != 0 || line.size() == 5 || line.size() > 13 ||
+      line.find_first_not_of("0123456789", 5) != std::string::npos) {
+    return;
+  }
+  switchBaud(std::stoi(line.substr(5)));
+  if (baud != DEFAULT_BAUD) {
+    handshakeTimer(std::chrono::milliseconds(BAUD_CHECK_TIMEOUT), [this] {
+      logData("No answer at " + std::to_string(baud) + " baud.");
+      switchBaud(DEFAULT_BAUD);
+    });
+  }
+}
+
+void SerialReader::Runner::phasesLine(const std::string& line) {
+  // "Phases: <phase>=<us> ...", sent by the firmware as the last line before the "|$" which ends a readout
+  std::istringstream iss(line.substr(std::strlen(PHASES_PREFIX)));
+  std::string field;
+  std::string phases;
+  while (iss >> field) {
+    const size_t equals = field.find('=');
+    if (equals == std::string::npos || equals == 0 || equals == field.size() - 1 ||
+        field.find_first_not_of("0123456789", equals + 1) != std::string::npos) {
+      continue;
+    }
+    phases += field.substr(0, equals) + " " + field.substr(equals + 1) + "\n";
+  }
+  measurement->phases = phases;
+}
+
+void SerialReader::Runner::switchBaud(const int newBaud) {
+  if (newBaud == baud) {
+    return;
+  }
+  serialDrain(fd);
+  if (!uartSetBaud(fd, newBaud)) {
+    logData("Can't switch the serial port to " + std::to_string(newBaud) + " baud.");
+    return;
+  }
+  baud = newBaud;
+  logData("Switched to " + std::to_string(baud) + " baud.");
+}
+
+bool SerialReader::Runner::feedPayload(const std::string_view data) {
+  Measurement& m = *measurement;
+  m.decoder->feed(data);
+  const size_t before = m.payloadCount;
+  m.payloadCount = m.decoder->payloadBytes();
+  if (name.empty() && m.payloadCount / FLUSH_INTERVAL != before / FLUSH_INTERVAL) {
+    std::cout << '\r' << m.payloadCount << " bytes written." << std::flush;
+  }
+  if (m.decoder->done()) {
+    return true;
+  }
+  m.lastPayload = std::chrono::steady_clock::now();
+  if (!m.stallCheck) {
+    m.stallCheck = true;
+    checkStall(std::chrono::milliseconds(STALL_TIMEOUT));
+  }
+  return false;
+}
+
+void SerialReader::Runner::checkStall(const std::chrono::steady_clock::duration delay) {
+  measurement->events.schedule(delay, [this] {
+    if (!measurement || !measurement->stallCheck) return;
+    Measurement& m = *measurement;
+    if (!m.decoder || m.decoder->done()) {
+      m.stallCheck = false;
+      return;
+    }
+    const auto idle = std::chrono::steady_clock::now() - m.lastPayload;
+    if (idle < std::chrono::milliseconds(STALL_TIMEOUT)) {
+      checkStall(std::chrono::milliseconds(STALL_TIMEOUT) - idle);
+      return;
+    }
+    // Checked again once more bytes arrive
+    m.stallCheck = false;
+    if (!m.decoder->stall()) return;
+    const std::string text(m.decoder->rest());
+    process(text);
+    if (m.finished) complete();
+  });
+}
+
+void SerialReader::Runner::logChunks(const ChunkDecoder& decoder) {
+  if (decoder.crcErrors() == 0 && decoder.filled().empty()) {
+    return;
+  }
+  std::ostringstream oss;
+  oss << decoder.crcErrors() << " CRC errors, " << decoder.resentChunks() << " chunks received again, "
+      << decoder.filled().size() << " chunks filled with zeros";
+  for (size_t i = 0; i < decoder.filled().size(); i++) {
+    oss << (i == 0 ? ": " : ", ") << decoder.filled()[i];
+  }
+  logData(oss.str());
+}
+
+void SerialReader::Runner::logEncoding(const ReadoutExpander& expander, const size_t payloadBytes) {
+  if (!expander.isSparse() && !expander.isCompressed()) {
+    return;
+  }
+  std::ostringstream oss;
+  oss << (expander.isSparse() ? "Sparse" : "Compressed") << " readout of " << expander.cells() << " cells";
+  if (expander.isSparse() && !measurement->parser.getKeepEncoded()) {
+    oss << ", " << expander.changedCells() << " changed";
+  }
+  if (payloadBytes > 0) {
+    oss << ", ratio " << std::fixed << std::setprecision(1)
+        << static_cast<double>(expander.cells()) * 4 / static_cast<double>(payloadBytes) << ":1";
+  }
+  oss << (measurement->parser.getKeepEncoded() ? ", written as received." : ", expanded to a full memory dump.");
+  logData(oss.str());
+}
+
+void SerialReader::Runner::writeTags(const ChunkDecoder& decoder) {
+  if (decoder.tags().empty()) {
+    return;
+  }
+  // One line per run of chunks with the same tag: payload offset, bytes, first address and tag
+  std::ostringstream oss;
+  const auto& tags = decoder.tags();
+  for (auto first = tags.begin(); first != tags.end();) {
+    auto last = first;
+    for (auto next = std::next(last); next != tags.end() && next->first == last->first + 1 &&
+         next->second.tag == first->second.tag; ++next) {
+      last = next;
+    }
+    oss << static_cast<uint64_t>(first->first) * CHUNK_SIZE << " "
+        << static_cast<uint64_t>(last->first - first->first + 1) * CHUNK_SIZE << " " << std::hex << std::uppercase
+        << std::setw(8) << std::setfill('0') << first->second.address << std::dec << " " << first->second.tag << "\n";
+    first = std::next(last);
+  }
+  logData("Chunk tags (offset, bytes, address, tag):\n" + oss.str());
+  if (const auto* w = dynamic_cast<AsyncWriter*>(measurement->output.rdbuf())) {
+    std::ofstream(w->getPath() + ".tags") << oss.str();
+  }
+}
+
+void SerialReader::Runner::writePhases() {
+  Measurement& m = *measurement;
+  if (m.phases.empty()) {
+    return;
+  }
+  if (const auto* w = dynamic_cast<AsyncWriter*>(m.output.rdbuf())) {
+    std::ofstream(w->getPath() + ".phases") << m.phases;
+  }
+  m.phases.clear();
+}
+
+void SerialReader::Runner::finishOutput() {
+  Measurement& m = *measurement;
+  if (m.decoder) {
+    m.decoder->finish();
+    m.payloadCount = m.decoder->payloadBytes();
+    runnerStats.payloadBytes += m.payloadCount;
+    const auto transferTime = std::chrono::steady_clock::now() - m.transferStart;
+    runnerStats.transferTime += transferTime;
+    logData(std::to_string(m.payloadCount) + " bytes in total written in " +
+            std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(transferTime).count()) + " ms.");
+    logChunks(*m.decoder);
+    writeTags(*m.decoder);
+    m.decoder.reset();
+    m.expander->finish();
+    logEncoding(*m.expander, m.payloadCount);
+    m.expanded.reset();
+    m.expander.reset();
+  }
+  // Text readouts (modes 2 and 3) send their phases as well
+  writePhases();
+  closeOutput();
+}
+
+void SerialReader::Runner::closeOutput() {
+  std::ostream& output = measurement->output;
+  output.flush();
+  if (auto* o = dynamic_cast<std::ofstream*>(&output)) {
+    o->close();
+  }
+  if (auto* w = dynamic_cast<AsyncWriter*>(output.rdbuf())) {
+    w->close();
+    if (const WriterStats stats = w->stats(); stats.buffersWritten > 0 || stats.error != 0) {
+      logData(writerStats(stats));
+    }
+  }
+}
+
+void SerialReader::Runner::receive(const uint32_t ready) {
+  Measurement& m = *measurement;
+  if (ready & (EPOLLERR | EPOLLHUP)) {
+    logData("Serial port failed, stopping.");
+    finishOutput();
+    m.running = false;
+    m.finished = true;
+  } else {
+    const ssize_t numBytes = read(fd, readBuf, BUFFER_SIZE);
+    if (numBytes <= 0) return;
+    process(std::string_view(readBuf, numBytes));
+    if (!m.finished) return;
+  }
+  complete();
+}
+
+void SerialReader::Runner::process(std::string_view received) {
+  Measurement& m = *measurement;
+  std::string text;
+  FrameScanner::Chunk chunk;
+
+  if (m.decoder && !m.decoder->done()) {
+    if (!feedPayload(received)) return;
+    text = m.decoder->rest();
+    received = text;
+  }
+
+  while (!m.finished && m.scanner.next(received, chunk)) {
+    if (chunk.marker == Marker::NONE && chunk.payload) {
+      // Text readouts, e.g. of mode 1, are written as received
+      m.output.write(chunk.data.data(), static_cast<std::streamsize>(chunk.data.size()));
+      const size_t before = m.payloadCount;
+      m.payloadCount += chunk.data.size();
+      if (name.empty() && m.payloadCount / FLUSH_INTERVAL != before / FLUSH_INTERVAL) {
+        std::cout << '\r' << m.payloadCount << " bytes written." << std::flush;
       }
-      if (parser.getMaxMeasures() > 0 && count >= parser.getMaxMeasures()) {
-        running = false;
+      continue;
+    }
+    if (chunk.marker == Marker::NONE) {
+      if (!chunk.data.empty()) {
+        m.synced = ChunkDecoder::framed(chunk.data);
       }
-    } else if (LOADED_1 == lastChar && LOADED_2 == in) {
-      input = new std::thread([this, &parser, &interrupt] {
-        for (auto& param : parser.getParams()) {
-          while (!expectInput) {
-            if (interrupt) return; // Shortcut thread
-          }
-          expectInput = false;
-          std::this_thread::sleep_for(std::chrono::milliseconds(50));
-          std::string toSend = param;
-          serialPuts(fd, toSend.c_str());
-          serialFlush(fd);
-          std::this_thread::sleep_for(std::chrono::milliseconds(50));
-          toSend = "\r";
-          serialPuts(fd, toSend.c_str());
-          serialFlush(fd);
+      logLive(chunk.data);
+      if (m.handshake == Handshake::ECHO) {
+        m.echo += chunk.data;
+        if (m.echo.find(m.answer) != std::string::npos) {
+          confirmParam();
         }
-      });
-    } else if (ASK_INPUT_1 == lastChar && ASK_INPUT_2 == in) {
-      expectInput = true;
-    } else if (FINISHED_1 == lastChar && FINISHED_2 == in) {
-      interrupt = true;
-      if (input != nullptr) {
-        input->join();
-        delete input;
-        input = nullptr;
       }
-    } else if (PANIC_1 == lastChar && PANIC_2 == in) {
-      interrupt = true;
-      if (input != nullptr) {
-        input->join();
-        delete input;
-        input = nullptr;
-      }
-      output.flush();
-      if (auto* o = dynamic_cast<std::ofstream*>(&output)) {
-        o->close();
+      for (const char c : chunk.data) {
+        if (c == '\n') {
+          textLine(m.line);
+          m.line.clear();
+        } else if (c != '\r' && m.line.size() < BUFFER_SIZE) {
+          m.line += c;
+        }
       }
+      continue;
     }
-    if (writePuf && charCount > 1) {
-      output << lastChar;
+
+    if (chunk.marker != Marker::END) {
+      logLive(FrameScanner::text(chunk.marker));
     }
-    lastChar = in;
-    if (writePuf) {
-      ++charCount;
-      if (charCount % FLUSH_INTERVAL == 0) {
-        std::cout << '\r' << charCount << " bytes written." << std::flush;
-        output.flush();
+    switch (chunk.marker) {
+    case Marker::START:
+      ++handshakeStep;
+      m.handshake = Handshake::IDLE;
+      m.transferStart = std::chrono::steady_clock::now();
+      m.payloadCount = 0;
+      if (!m.synced) {
+        break;
+      }
+      m.synced = false;
+      // The chunks are decoded by their lengths, the scanner only takes over again after the end chunk
+      m.scanner.reset();
+      m.expander = std::make_unique<ReadoutExpander>(m.output, m.parser.getKeepEncoded());
+      m.expanded = std::make_unique<std::ostream>(m.expander.get());
+      m.decoder = std::make_unique<ChunkDecoder>(*m.expanded);
+      if (!feedPayload(received)) {
+        received = {};
+        break;
       }
+      text = m.decoder->rest();
+      received = text;
+      break;
+    case Marker::END:
+      ++m.count;
+      ++runnerStats.measurements;
+      if (!m.decoder) {
+        runnerStats.payloadBytes += m.payloadCount;
+        runnerStats.transferTime += std::chrono::steady_clock::now() - m.transferStart;
+        logData(std::to_string(m.payloadCount) + " bytes in total written.");
+      }
+      // The output is finished with FINISHED, after the firmware has sent missing chunks again
+      m.handshake = Handshake::READY;
+      if (m.parser.getMaxMeasures() > 0 && m.count >= m.parser.getMaxMeasures()) {
+        m.running = false;
+      }
+      break;
+    case Marker::LOADED:
+      ++handshakeStep;
+      m.handshake = Handshake::READY;
+      m.nextParam = 0;
+      m.commandSent = false;
+      break;
+    case Marker::ASK_INPUT:
+      prompted();
+      break;
+    case Marker::FINISHED:
+      finishOutput();
+      m.finished = true;
+      break;
+    case Marker::PANIC:
+      ++runnerStats.panics;
+      finishOutput();
+      m.finished = true;
+      break;
+    default:
+      break;
     }
+    m.line.clear();
   }
-  std::cout << std::endl;
-#ifdef USER_INPUT
-    inputUser.detach();
-#endif
-  return running;
+  if (m.finished) {
+    pending = received;
+  }
+}
+
+void SerialReader::Runner::complete() {
+  Measurement& m = *measurement;
+  m.events.unwatch(fd);
+  const auto done = std::move(m.done);
+  const bool running = m.running;
+  measurement.reset();
+  done(running);
 }
 
 void SerialReader::Runner::release() const {
@@ -2,45 +2,207 @@
 
 #define FLUSH_INTERVAL 10000
 #define BUFFER_SIZE 1024
+// Milliseconds to wait for the kernel's check prompt after switching to a new baud rate
+#define BAUD_CHECK_TIMEOUT 500
+// Milliseconds without bytes after which a readout waiting for the rest of a chunk ends at a trailer, well below the
+// time the firmware waits for resend requests (RESEND_TIMEOUT_S in getpuf/chunk.c)
+#define STALL_TIMEOUT 1000
+// Chunks asked for in one request, and how often the host goes over the chunks still missing
+#define RESEND_BATCH 64
+#define MAX_RESEND_ROUNDS 3
+// Params of a job which the kernel also takes in one line, and the menu entry offering it
+#define COMMAND_FIELDS 9
+#define COMMAND_PROMPT "!: one-line command"
+// Trailer line of the firmware with the duration of every phase of a measurement
+#define PHASES_PREFIX "Phases: "
 
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 #include <gpiod.hpp>
+#include "chunk.h"
+#include "eventloop.h"
+#include "expander.h"
+#include "gpio_utils.h"
+#include "scanner.h"
 
 namespace SerialReader {
   void run(Parser& parser);
 
   void run(Parser& parser, std::ostream& output);
 
+  struct RunnerStats {
+    int measurements = 0;
+    int panics = 0;
+    size_t payloadBytes = 0;
+    std::chrono::steady_clock::duration transferTime{0};
+  };
+
   class Runner {
   private:
+    /**
+     * Where the parameter handshake with the kernel menu stands. After LOADED, every prompt (|:) is answered with
+     * the next parameter once the parameter delay has passed. The parameter is confirmed with a carriage return as
+     * soon as the kernel has echoed it back, or after another parameter delay if the echo does not show up.
+     * If the kernel menu offers it, a full set of parameters is sent as one command line instead. Should the kernel
+     * reject it, the menu comes again and is answered parameter by parameter.
+     * The baud rate prompts of the kernel, the positions, schedule and probes prompts of the stable bits, staggered
+     * and adaptive modes and the resend prompts of the firmware after a readout are answered by the runner itself
+     * and don't consume a parameter.
+     */
+    enum class Handshake {
+      IDLE,
+      READY,
+      PROMPTED,
+      ECHO
+    };
+
+    struct Measurement {
+      Measurement(Parser& parser, const std::vector<std::string>& params, std::ostream& output, int& count,
+                  EventLoop& events, std::function<void(bool)> done)
+        : parser(parser), params(params), output(output), count(count), events(events), done(std::move(done)) {}
+
+      Parser& parser;
+      const std::vector<std::string>& params;
+      std::ostream& output;
+      int& count;
+      EventLoop& events;
+      std::function<void(bool)> done;
+      FrameScanner scanner;
+      // The decoder writes through the expander, which passes dense readouts on unchanged
+      std::unique_ptr<ReadoutExpander> expander;
+      std::unique_ptr<std::ostream> expanded;
+      std::unique_ptr<ChunkDecoder> decoder;
+      // The text before the next START ended with the SYN bytes of a chunked readout
+      bool synced = false;
+      bool stallCheck = false;
+      std::chrono::steady_clock::time_point lastPayload;
+      bool resuming = false;
+      bool uploading = false;
+      bool commandSent = false;
+      uint32_t resendFrom = 0;
+      int resendRound = 0;
+      size_t payloadCount = 0;
+      Handshake handshake = Handshake::IDLE;
+      size_t nextParam = 0;
+      std::string answer;
+      std::string echo;
+      std::string line;
+      bool running = true;
+      bool finished = false;
+      std::chrono::steady_clock::time_point transferStart;
+      // Phase timing trailer of the firmware, one "<phase> <us>" line per phase
+      std::string phases;
+    };
+
     const int fd;
     const gpiod::chip gpioChip;
     const gpiod::line gpioRelayLine;
+    const std::string name;
+    const int targetBaud;
+    int baud = DEFAULT_BAUD;
+
+    std::shared_ptr<std::ostream> log;
+    // Encoded stable.pos, loaded at the first "Positions" prompt
+    std::string positions;
+    std::string liveLine;
+    // What came after the end of the last job, the next job of the same boot starts with it
+    std::string pending;
+
+    std::unique_ptr<Measurement> measurement;
+    unsigned handshakeStep = 0;
+    RunnerStats runnerStats;
+    char readBuf[BUFFER_SIZE];
+
+    void receive(uint32_t ready);
+
+    void process(std::string_view received);
+
+    void complete();
+
+    void prompted();
+
+    void sendParam();
+
+    void confirmParam();
+
+    void handshakeTimer(std::chrono::milliseconds delay, std::function<void()> callback);
+
+    void textLine(const std::string& line);
+
+    void phasesLine(const std::string& line);
+
+    void switchBaud(int newBaud);
+
+    bool feedPayload(std::string_view data);
+
+    void checkStall(std::chrono::steady_clock::duration delay);
 
-    std::ofstream log;
-
-    const char LOADED_1 = '$';
-    const char LOADED_2 = '|';
-    const char ASK_INPUT_1 = '|';
-    const char ASK_INPUT_2 = ':';
-    const char FINISHED_1 = '|';
-    const char FINISHED_2 = '$';
-    const char START_1 = '&';
-    const char START_2 = '|';
-    const char END_1 = '|';
-    const char END_2 = '&';
-    const char PANIC_1 = '$';
-    const char PANIC_2 = '&';
+    void logChunks(const ChunkDecoder& decoder);
+
+    void logEncoding(const ReadoutExpander& expander, size_t payloadBytes);
+
+    void writeTags(const ChunkDecoder& decoder);
+
+    void writePhases();
+
+    std::string nextResend();
+
+    std::string positionsAnswer();
+
+    void finishOutput();
+
+    void closeOutput();
+
+    void logLive(std::string_view text);
 
   public:
-    Runner(const char* port, const char* chipName, int usb, int baud);
+    /**
+     * A runner with a name prefixes everything it logs with it, so several boards can share one log.
+     * Without a log, a new one is opened (only written if LOG is defined).
+     * The port is opened at 115200 baud, baud is the rate negotiated with the kernel once it has booted.
+     */
+    Runner(const char* port, const char* chipName, int usb, int baud, bool flowControl, std::string name = "",
+           std::shared_ptr<std::ostream> log = nullptr);
+
+    static std::shared_ptr<std::ostream> openLog();
+
+    void logData(const std::string& data);
 
     void reset(const Parser& parser);
 
+    void powerOff();
+
+    void powerOn();
+
     bool loop(Parser& parser, std::ostream& output, int& count);
 
-    void release() const;
+    /**
+     * Receives one measurement answering the kernel menu with params. If booted is set, the sender is still running
+     * from the last measurement and offers the menu again without a boot (see runJobs).
+     */
+    bool loop(Parser& parser, const std::vector<std::string>& params, bool booted, std::ostream& output, int& count);
+
+    /**
+     * Starts receiving one measurement on the given event loop without blocking.
+     * done is called with false once the maximum number of measurements has been reached.
+     */
+    void start(EventLoop& events, Parser& parser, std::ostream& output, int& count, std::function<void(bool)> done);
 
-    volatile bool expectInput = false;
+    void start(EventLoop& events, Parser& parser, const std::vector<std::string>& params, bool booted,
+               std::ostream& output, int& count, std::function<void(bool)> done);
+
+    [[nodiscard]] const RunnerStats& stats() const {
+      return runnerStats;
+    }
+
+    [[nodiscard]] const std::string& getName() const {
+      return name;
+    }
+
+    void release() const;
   };
 }
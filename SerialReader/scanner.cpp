@@ -0,0 +1,109 @@
+#include <cstring>
+#include "scanner.h"
+
+SerialReader::Marker SerialReader::FrameScanner::match(const char first, const char second) const {
+  if (payload) {
+    return first == '|' && second == '&' ? Marker::END : Marker::NONE;
+  }
+  switch (first) {
+  case '$':
+    if (second == '|') return Marker::LOADED;
+    if (second == '&') return Marker::PANIC;
+    break;
+  case '|':
+    if (second == ':') return Marker::ASK_INPUT;
+    if (second == '$') return Marker::FINISHED;
+    if (second == '&') return Marker::END;
+    break;
+  case '&':
+    if (second == '|') return Marker::START;
+    break;
+  default:
+    break;
+  }
+  return Marker::NONE;
+}
+
+size_t SerialReader::FrameScanner::findLead(const std::string_view input, const size_t pos) const {
+  if (payload) {
+    const void* found = std::memchr(input.data() + pos, '|', input.size() - pos);
+    return found == nullptr ? std::string_view::npos : static_cast<const char*>(found) - input.data();
+  }
+  return input.find_first_of("$|&", pos);
+}
+
+void SerialReader::FrameScanner::enter(const Marker marker) {
+  if (marker == Marker::START) {
+    payload = true;
+  } else if (marker == Marker::END) {
+    payload = false;
+  }
+}
+
+bool SerialReader::FrameScanner::next(std::string_view& input, Chunk& chunk) {
+  chunk = Chunk{Marker::NONE, payload, {}};
+  if (input.empty()) {
+    return false;
+  }
+  if (hasHeld) {
+    hasHeld = false;
+    if (const Marker marker = match(held, input.front()); marker != Marker::NONE) {
+      input.remove_prefix(1);
+      chunk.marker = marker;
+      enter(marker);
+    } else {
+      chunk.data = std::string_view(&held, 1);
+    }
+    return true;
+  }
+
+  size_t pos = 0;
+  while ((pos = findLead(input, pos)) != std::string_view::npos) {
+    if (pos + 1 == input.size()) {
+      held = input[pos];
+      hasHeld = true;
+      chunk.data = input.substr(0, pos);
+      input = {};
+      return !chunk.data.empty();
+    }
+    if (const Marker marker = match(input[pos], input[pos + 1]); marker != Marker::NONE) {
+      if (pos > 0) {
+        chunk.data = input.substr(0, pos);
+        input.remove_prefix(pos);
+      } else {
+        chunk.marker = marker;
+        input.remove_prefix(2);
+        enter(marker);
+      }
+      return true;
+    }
+    ++pos;
+  }
+  chunk.data = input;
+  input = {};
+  return true;
+}
+
+void SerialReader::FrameScanner::reset() {
+  payload = false;
+  hasHeld = false;
+}
+
+std::string_view SerialReader::FrameScanner::text(const Marker marker) {
+  switch (marker) {
+  case Marker::LOADED:
+    return "$|";
+  case Marker::ASK_INPUT:
+    return "|:";
+  case Marker::FINISHED:
+    return "|$";
+  case Marker::START:
+    return "&|";
+  case Marker::END:
+    return "|&";
+  case Marker::PANIC:
+    return "$&";
+  default:
+    return "";
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace SerialReader {
+  enum class Marker {
+    NONE,
+    LOADED,    // $|
+    ASK_INPUT, // |:
+    FINISHED,  // |$
+    START,     // &|
+    END,       // |&
+    PANIC      // $&
+  };
+
+  /**
+   * Splits the raw serial stream into text spans, payload spans and the two-byte markers sent by the firmware.
+   * Instead of looking at every byte, it searches each buffer for the first byte of a marker and hands out
+   * everything in between as one span. Outside of a payload all markers are recognised, inside a payload only END
+   * is, so PUF data can never be mistaken for a control sequence other than the end marker itself.
+   * Chunked readouts (see chunk.h) are framed by length instead: the runner takes them over after START and calls
+   * reset(), the END following the end chunk is then recognised in text mode.
+   */
+  class FrameScanner {
+  public:
+    struct Chunk {
+      Marker marker = Marker::NONE;
+      bool payload = false;
+      std::string_view data;
+    };
+
+    /**
+     * Consumes the next span or marker from input. Returns false once input is exhausted.
+     * A chunk either carries data (marker == NONE) or a marker (data is empty). If the buffer ends with the first
+     * half of a possible marker, that byte is held back and resolved on the next call; data may then point into the
+     * scanner itself and is only valid until the next call.
+     */
+    bool next(std::string_view& input, Chunk& chunk);
+
+    [[nodiscard]] bool inPayload() const {
+      return payload;
+    }
+
+    /**
+     * Drops a held back byte and returns to text mode.
+     */
+    void reset();
+
+    static std::string_view text(Marker marker);
+
+  private:
+    [[nodiscard]] Marker match(char first, char second) const;
+
+    [[nodiscard]] size_t findLead(std::string_view input, size_t pos) const;
+
+    void enter(Marker marker);
+
+    bool payload = false;
+    bool hasHeld = false;
+    char held = 0;
+  };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iostream>
+
+/*
+ * Checks of the unit tests, which run without a test framework: every failed check is printed with its line and
+ * the test exits with 1 (see result()).
+ */
+namespace SerialReader::Test {
+  inline int failures = 0;
+
+  inline void check(const bool ok, const char* what, const char* file, const int line) {
+    if (!ok) {
+      std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+      ++failures;
+    }
+  }
+
+  inline int result() {
+    return failures == 0 ? 0 : 1;
+  }
+}
+
+#define CHECK(expr) SerialReader::Test::check((expr), #expr, __FILE__, __LINE__)
@@ -0,0 +1,185 @@
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../chunk.h"
+#include "check.h"
+
+using SerialReader::ChunkDecoder;
+
+/* Unit tests of the ChunkDecoder: the end of a readout by end chunk or by the "|&" trailer, and broken chunks. */
+
+static std::string be(const uint32_t value, const size_t size) {
+  std::string bytes;
+  for (size_t i = size; i-- > 0;) {
+    bytes += static_cast<char>(value >> (8 * i));
+  }
+  return bytes;
+}
+
+/**
+ * A chunk as getpuf/chunk.c sends it, an end chunk without payload.
+ */
+static std::string chunk(const uint32_t seq, const uint32_t address, const std::string& payload) {
+  const std::string body = be(seq, 4) + be(address, 4) + be(payload.size(), 2) + payload;
+  return std::string("PUF\x16", 4) + body + be(SerialReader::crc32(body), 4);
+}
+
+static std::string payload(const uint32_t seq, const size_t size = CHUNK_SIZE) {
+  std::string data(size, 0);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<char>(seq * 31 + i);
+  }
+  return data;
+}
+
+static const std::string HEADER = "0C3000000,";
+
+static void endChunk() {
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  const std::string last = payload(1, 100);
+  decoder.feed(HEADER + chunk(0, 0xC3000000, payload(0)));
+  CHECK(!decoder.done());
+  decoder.feed(chunk(1, 0xC3000400, last) + chunk(2, CHUNK_SIZE + 100, "") + "|&281\n|$");
+  CHECK(decoder.done());
+  CHECK(decoder.rest() == "|&281\n|$");
+  decoder.finish();
+  CHECK(out.str() == HEADER + payload(0) + last);
+  CHECK(decoder.payloadBytes() == CHUNK_SIZE + 100);
+  CHECK(decoder.missing().empty());
+  CHECK(decoder.filled().empty());
+  CHECK(decoder.crcErrors() == 0);
+}
+
+static void lostEndChunk() {
+  // The end chunk and the last chunk are lost, the trailer gives the size: 625 cells, the last chunk 452 bytes
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  decoder.feed(HEADER + chunk(0, 0xC3000000, payload(0)) + chunk(1, 0xC3000400, payload(1)));
+  decoder.feed("garbage|");
+  CHECK(!decoder.done());
+  decoder.feed("&625\r\n");
+  CHECK(decoder.done());
+  CHECK(decoder.missing() == std::vector<uint32_t>({2}));
+  decoder.finish();
+  CHECK(out.str() == HEADER + payload(0) + payload(1) + std::string(452, 0));
+  CHECK(decoder.filled() == std::vector<uint32_t>({2}));
+}
+
+static void trailerNumbers() {
+  // "|&" followed by anything but digits and a line break is no trailer, e.g. inside the text of a header
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  decoder.feed(HEADER + "|&12x |& |&");
+  CHECK(!decoder.done());
+  decoder.feed("4|$");
+  CHECK(decoder.done());
+  decoder.finish();
+  CHECK(out.str() == HEADER + std::string(16, 0));
+}
+
+static void crcMismatch() {
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  std::string broken = chunk(1, 0xC3000400, payload(1));
+  broken[20] ^= 0x40;
+  decoder.feed(HEADER + chunk(0, 0xC3000000, payload(0)) + broken + chunk(2, 0xC3000800, payload(2, 8)) +
+               chunk(3, 2 * CHUNK_SIZE + 8, "") + "|&514\n");
+  CHECK(decoder.done());
+  CHECK(decoder.crcErrors() == 1);
+  CHECK(decoder.missing() == std::vector<uint32_t>({1}));
+  // Chunk 2 is held back until chunk 1 has been sent again
+  CHECK(out.str() == HEADER + payload(0));
+
+  decoder.resume();
+  decoder.feed(chunk(1, 0xC3000400, payload(1)) + chunk(3, 2 * CHUNK_SIZE + 8, "") + "Resend chunks|: ");
+  CHECK(decoder.done());
+  CHECK(decoder.resentChunks() == 1);
+  CHECK(decoder.missing().empty());
+  decoder.finish();
+  CHECK(out.str() == HEADER + payload(0) + payload(1) + payload(2, 8));
+  CHECK(decoder.filled().empty());
+}
+
+static void brokenLength() {
+  // A damaged length makes the chunk look longer than it is, the trailer still ends the readout
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  std::string broken = chunk(0, 0xC3000000, payload(0, 16));
+  broken[13] = 0x01;
+  decoder.feed(HEADER + broken + "|&4\n");
+  CHECK(decoder.done());
+  CHECK(decoder.crcErrors() == 1);
+  decoder.finish();
+  CHECK(out.str() == HEADER + std::string(16, 0));
+}
+
+static void stalledChunk() {
+  // The damaged length makes the chunk wait for more bytes than were sent, the trailer only counts once nothing else
+  // arrives
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  std::string broken = chunk(0, 0xC3000000, payload(0, 16));
+  broken[12] = 0x01;
+  decoder.feed(HEADER + broken + "|&4\n");
+  CHECK(!decoder.done());
+  CHECK(decoder.stall());
+  CHECK(decoder.rest() == "|&4\n");
+  CHECK(decoder.crcErrors() == 1);
+  decoder.finish();
+  CHECK(out.str() == HEADER + std::string(16, 0));
+}
+
+static void trailerInPayload() {
+  // Payload bytes which look like a trailer, received in small reads
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  std::string first = payload(0);
+  first.replace(100, 4, "|&7|");
+  std::string last = payload(1, 24);
+  last.replace(0, 5, "|&12\n");
+  const std::string stream = HEADER + chunk(0, 0xC3000000, first) + chunk(1, 0xC3000400, last);
+  for (size_t i = 0; i < stream.size(); i += 7) {
+    decoder.feed(std::string_view(stream).substr(i, 7));
+  }
+  CHECK(!decoder.done());
+  decoder.feed(chunk(2, CHUNK_SIZE + 24, "") + "|&262\n");
+  CHECK(decoder.done());
+  CHECK(decoder.rest() == "|&262\n");
+  CHECK(decoder.crcErrors() == 0);
+  decoder.finish();
+  CHECK(out.str() == HEADER + first + last);
+}
+
+static void framedReadouts() {
+  // puf_header sends SYN bytes before "&|", the text readout of mode 1 doesn't
+  CHECK(ChunkDecoder::framed("Reading\r\n\x16\x16\x16"));
+  CHECK(!ChunkDecoder::framed("Reading\r\n"));
+  CHECK(!ChunkDecoder::framed(""));
+}
+
+static void byteByByte() {
+  std::ostringstream out;
+  ChunkDecoder decoder(out);
+  const std::string stream = HEADER + chunk(0, 0xC3000000, payload(0)) + chunk(1, 0xC3000400, payload(1, 4)) +
+                             chunk(2, CHUNK_SIZE + 4, "") + "|&257\n";
+  for (const char c : stream) {
+    decoder.feed(std::string_view(&c, 1));
+  }
+  CHECK(decoder.done());
+  decoder.finish();
+  CHECK(out.str() == HEADER + payload(0) + payload(1, 4));
+}
+
+int main() {
+  endChunk();
+  lostEndChunk();
+  trailerNumbers();
+  crcMismatch();
+  brokenLength();
+  stalledChunk();
+  trailerInPayload();
+  framedReadouts();
+  byteByByte();
+  return SerialReader::Test::result();
+}
@@ -0,0 +1,158 @@
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../chunk.h"
+#include "../expander.h"
+#include "check.h"
+
+using SerialReader::ReadoutExpander;
+
+/* Unit tests of the ReadoutExpander: sparse and run length encoded readouts, split at buffer and chunk boundaries. */
+
+static std::string be(const uint32_t value) {
+  return {static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8),
+          static_cast<char>(value)};
+}
+
+static std::string words(const std::vector<uint32_t>& values) {
+  std::string bytes;
+  for (const uint32_t value : values) {
+    bytes += be(value);
+  }
+  return bytes;
+}
+
+/**
+ * Literal token of getpuf/GetPuf.c (puf_encode_rle).
+ */
+static std::string literal(const std::vector<uint32_t>& values) {
+  return static_cast<char>(values.size()) + words(values);
+}
+
+static std::string run(const uint32_t count, const uint32_t value) {
+  std::string token = "\x80";
+  uint32_t n = count;
+  while (n >= 0x80) {
+    token += static_cast<char>((n & 0x7F) | 0x80);
+    n >>= 7;
+  }
+  return token + static_cast<char>(n) + be(value);
+}
+
+/**
+ * Writes the stream in pieces of the given sizes, the rest in one piece, and finishes the expander.
+ */
+static std::string expand(const std::string& stream, const std::vector<size_t>& pieces = {},
+                          const bool keepEncoded = false) {
+  std::ostringstream out;
+  ReadoutExpander expander(out, keepEncoded);
+  std::ostream in(&expander);
+  size_t pos = 0;
+  for (const size_t size : pieces) {
+    in.write(stream.data() + pos, static_cast<std::streamsize>(size));
+    pos += size;
+  }
+  in.write(stream.data() + pos, static_cast<std::streamsize>(stream.size() - pos));
+  in.flush();
+  expander.finish();
+  return out.str();
+}
+
+static void dense() {
+  const std::string stream = "0C3000000," + words({1, 2, 3});
+  CHECK(expand(stream, {3, 9}) == stream);
+}
+
+static void sparse() {
+  // Cells 1 and 5 of 7 changed, the chunk padded with zeros
+  std::string stream = "0C3000000:FFFFFFFF:00000007,";
+  const std::string records = "\x02" + be(0x0000000F) + "\x04" + be(0xF0000000);
+  stream += records + std::string(8, 0);
+  const std::string expected = "0C3000000," + words({0xFFFFFFFF, 0xFFFFFFF0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+                                                     0x0FFFFFFF, 0xFFFFFFFF});
+  CHECK(expand(stream) == expected);
+  // Split within the header, a delta and a value
+  CHECK(expand(stream, {5, 24, 1, 2, 4}) == expected);
+  CHECK(expand(stream, {}, true) == stream);
+}
+
+static void sparseChunks() {
+  // Every chunk counts its deltas from its first record, the second chunk starts at cell 300
+  std::string first = "\x01" + be(1);
+  first += std::string(CHUNK_SIZE - first.size(), 0);
+  const std::string second = std::string("\xAD\x02", 2) + be(2) + std::string(3, 0);
+  std::ostringstream out;
+  ReadoutExpander expander(out, false);
+  std::ostream in(&expander);
+  in << "0C3000000:00000000:00000200,";
+  in.write(first.data(), static_cast<std::streamsize>(first.size()));
+  in.write(second.data(), static_cast<std::streamsize>(second.size()));
+  in.flush();
+  expander.finish();
+  CHECK(expander.isSparse());
+  CHECK(expander.changedCells() == 2);
+  std::vector<uint32_t> cells(0x200, 0);
+  cells[0] = 1;
+  cells[300] = 2;
+  CHECK(out.str() == "0C3000000," + words(cells));
+}
+
+static void rle() {
+  const std::string stream = "0C3000000;00000006," + be(0) + literal({0xA, 0xB}) + run(4, 0xC) + std::string(2, 0);
+  const std::string expected = "0C3000000," + words({0xA, 0xB, 0xC, 0xC, 0xC, 0xC});
+  CHECK(expand(stream) == expected);
+  // The literal split at a buffer boundary, in its count, inside its first word and between its words
+  const size_t literalStart = std::string("0C3000000;00000006,").size() + 4;
+  CHECK(expand(stream, {literalStart}) == expected);
+  CHECK(expand(stream, {literalStart + 1}) == expected);
+  CHECK(expand(stream, {literalStart + 3}) == expected);
+  CHECK(expand(stream, {literalStart + 5, 1, 1, 1, 1}) == expected);
+  // A run longer than a varint byte
+  CHECK(expand("0C3000000;00000100," + be(0) + run(0x100, 7)) ==
+        "0C3000000," + words(std::vector<uint32_t>(0x100, 7)));
+}
+
+static void rleChunkBoundary() {
+  // Literals filling the first chunk exactly: 4 + 4 tokens + 4 * 254 words = CHUNK_SIZE
+  std::vector<uint32_t> values(254);
+  for (uint32_t i = 0; i < values.size(); i++) {
+    values[i] = 0x1000 + i;
+  }
+  std::string first = be(0);
+  first += literal(std::vector<uint32_t>(values.begin(), values.begin() + 127));
+  first += literal(std::vector<uint32_t>(values.begin() + 127, values.begin() + 252));
+  first += literal({values[252]});
+  first += literal({values[253]});
+  CHECK(first.size() == CHUNK_SIZE);
+  const std::string second = be(254) + literal({0xEE}) + run(5, 0xFF) + std::string(1, 0);
+  const std::string stream = "0C3000000;00000104," + first + second;
+  std::vector<uint32_t> cells = values;
+  cells.push_back(0xEE);
+  cells.insert(cells.end(), 5, 0xFF);
+  const std::string expected = "0C3000000," + words(cells);
+  const size_t header = std::string("0C3000000;00000104,").size();
+  CHECK(expand(stream) == expected);
+  // Split right at the chunk boundary, in the last word of the chunk and in the first cell of the next one
+  CHECK(expand(stream, {header + CHUNK_SIZE}) == expected);
+  CHECK(expand(stream, {header + CHUNK_SIZE - 2, 4}) == expected);
+}
+
+static void rleLostChunk() {
+  // A chunk filled with zeros by the ChunkDecoder starts at cell 0 again, its cells stay zeros
+  const std::string first(CHUNK_SIZE, 0);
+  const std::string second = be(300) + run(2, 9);
+  std::vector<uint32_t> cells(302, 0);
+  cells[300] = 9;
+  cells[301] = 9;
+  CHECK(expand("0C3000000;0000012E," + first + second) == "0C3000000," + words(cells));
+}
+
+int main() {
+  dense();
+  sparse();
+  sparseChunks();
+  rle();
+  rleChunkBoundary();
+  rleLostChunk();
+  return SerialReader::Test::result();
+}
@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+#include "../scanner.h"
+#include "check.h"
+
+using SerialReader::FrameScanner;
+using SerialReader::Marker;
+
+/* Unit tests of the FrameScanner: markers in text and payload mode, and markers split over two reads. */
+
+/**
+ * Scans the buffers one after the other like consecutive reads of the serial port. Text spans between two markers
+ * are joined, so the result doesn't depend on where the scanner splits them: "<text>" for text, "[payload]" for
+ * payload and the marker itself for markers.
+ */
+static std::vector<std::string> scan(const std::vector<std::string>& buffers, FrameScanner& scanner) {
+  std::vector<std::string> tokens;
+  bool joinable = false;
+  for (const std::string& buffer : buffers) {
+    std::string_view input(buffer);
+    FrameScanner::Chunk chunk;
+    while (scanner.next(input, chunk)) {
+      if (chunk.marker != Marker::NONE) {
+        tokens.emplace_back(FrameScanner::text(chunk.marker));
+        joinable = false;
+        continue;
+      }
+      const std::string open = chunk.payload ? "[" : "<";
+      const std::string close = chunk.payload ? "]" : ">";
+      if (joinable && tokens.back().front() == open.front()) {
+        tokens.back().insert(tokens.back().size() - 1, chunk.data);
+      } else {
+        tokens.push_back(open + std::string(chunk.data) + close);
+      }
+      joinable = true;
+    }
+  }
+  return tokens;
+}
+
+static std::vector<std::string> scan(const std::vector<std::string>& buffers) {
+  FrameScanner scanner;
+  return scan(buffers, scanner);
+}
+
+static void textMarkers() {
+  CHECK(scan({"Booting$|Mode|: 0\r\n"}) == std::vector<std::string>({"<Booting>", "$|", "<Mode>", "|:", "< 0\r\n>"}));
+  CHECK(scan({"panic$&|$"}) == std::vector<std::string>({"<panic>", "$&", "|$"}));
+  // Lead bytes which don't start a marker stay text
+  CHECK(scan({"a|b&c$d"}) == std::vector<std::string>({"<a|b&c$d>"}));
+}
+
+static void payloadMarkers() {
+  FrameScanner scanner;
+  // Inside a payload only the end marker counts
+  CHECK(scan({"&|01$|23|:45|&6\n"}, scanner) ==
+        std::vector<std::string>({"&|", "[01$|23|:45]", "|&", "<6\n>"}));
+  CHECK(!scanner.inPayload());
+}
+
+static void textReadout() {
+  // Mode 1 prints its records between the payload markers, without chunks
+  CHECK(scan({"\r\n&|0C300001=0003,0C3", "00002=0002|&2\n|$\n"}) ==
+        std::vector<std::string>({"<\r\n>", "&|", "[0C300001=0003,0C300002=0002]", "|&", "<2\n>", "|$", "<\n>"}));
+}
+
+static void splitMarkers() {
+  // Every marker split between two reads
+  CHECK(scan({"text|", "$more"}) == std::vector<std::string>({"<text>", "|$", "<more>"}));
+  CHECK(scan({"$", "|"}) == std::vector<std::string>({"$|"}));
+  CHECK(scan({"abc&", "|data|", "&12"}) == std::vector<std::string>({"<abc>", "&|", "[data]", "|&", "<12>"}));
+  // A held back byte which turns out not to start a marker is handed out as data
+  CHECK(scan({"ab|", "xy"}) == std::vector<std::string>({"<ab|xy>"}));
+  CHECK(scan({"&|ab|", "x|", "&"}) == std::vector<std::string>({"&|", "[ab|x]", "|&"}));
+  // One byte per read
+  std::vector<std::string> bytes;
+  for (const char c : std::string("x&|p$|q|&y|$")) {
+    bytes.emplace_back(1, c);
+  }
+  CHECK(scan(bytes) == std::vector<std::string>({"<x>", "&|", "[p$|q]", "|&", "<y>", "|$"}));
+}
+
+static void reset() {
+  FrameScanner scanner;
+  scan({"&|abc|"}, scanner);
+  CHECK(scanner.inPayload());
+  // The runner takes over the payload and hands back text, the held back byte is dropped
+  scanner.reset();
+  CHECK(!scanner.inPayload());
+  CHECK(scan({"$text"}, scanner) == std::vector<std::string>({"<$text>"}));
+}
+
+int main() {
+  textMarkers();
+  payloadMarkers();
+  textReadout();
+  splitMarkers();
+  reset();
+  return SerialReader::Test::result();
+}
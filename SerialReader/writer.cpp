@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "writer.h"
+
+SerialReader::AsyncWriter::AsyncWriter(const std::string& path, const size_t bufferSize, const size_t ringSize)
+  : path(path), bufferSize(bufferSize), ringSize(ringSize), ring(std::make_unique<Slot[]>(ringSize)),
+    fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+  if (fd < 0) {
+    error = errno;
+  }
+  for (size_t i = 0; i < ringSize; i++) {
+    ring[i].data = std::make_unique<char[]>(bufferSize);
+  }
+  setp(ring[0].data.get(), ring[0].data.get() + bufferSize);
+  writerThread = std::thread([this] { drain(); });
+}
+
+SerialReader::AsyncWriter::~AsyncWriter() {
+  close();
+}
+
+void SerialReader::AsyncWriter::close() {
+  if (closed) return;
+  publish();
+  ring[head.load(std::memory_order_relaxed) % ringSize].size = 0;
+  head.fetch_add(1, std::memory_order_release);
+  head.notify_one();
+  writerThread.join();
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+  setp(nullptr, nullptr);
+  closed = true;
+}
+
+SerialReader::WriterStats SerialReader::AsyncWriter::stats() const {
+  WriterStats stats;
+  stats.bytesWritten = bytesWritten.load();
+  stats.buffersWritten = buffersWritten.load();
+  stats.occupancy = head.load() - tail.load();
+  stats.maxOccupancy = maxOccupancy;
+  stats.stallTime = stallTime;
+  stats.writeTime = std::chrono::nanoseconds(writeNanos.load());
+  stats.error = error.load();
+  return stats;
+}
+
+SerialReader::AsyncWriter::int_type SerialReader::AsyncWriter::overflow(const int_type ch) {
+  if (closed) return traits_type::eof();
+  publish();
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int SerialReader::AsyncWriter::sync() {
+  if (!closed) publish();
+  return error.load() == 0 ? 0 : -1;
+}
+
+void SerialReader::AsyncWriter::publish() {
+  const size_t size = pptr() - pbase();
+  if (size == 0) return;
+  const size_t current = head.load(std::memory_order_relaxed);
+  ring[current % ringSize].size = size;
+  head.store(current + 1, std::memory_order_release);
+  head.notify_one();
+  maxOccupancy = std::max(maxOccupancy, current + 1 - tail.load(std::memory_order_relaxed));
+  acquire();
+}
+
+void SerialReader::AsyncWriter::acquire() {
+  const size_t current = head.load(std::memory_order_relaxed);
+  size_t written = tail.load(std::memory_order_acquire);
+  if (current - written == ringSize) {
+    const auto start = std::chrono::steady_clock::now();
+    do {
+      tail.wait(written, std::memory_order_acquire);
+      written = tail.load(std::memory_order_acquire);
+    } while (current - written == ringSize);
+    stallTime += std::chrono::steady_clock::now() - start;
+  }
+  char* data = ring[current % ringSize].data.get();
+  setp(data, data + bufferSize);
+}
+
+void SerialReader::AsyncWriter::drain() {
+  for (;;) {
+    const size_t current = tail.load(std::memory_order_relaxed);
+    size_t published;
+    while ((published = head.load(std::memory_order_acquire)) == current) {
+      head.wait(published, std::memory_order_acquire);
+    }
+    const Slot& slot = ring[current % ringSize];
+    if (slot.size == 0) break;
+
+    const auto start = std::chrono::steady_clock::now();
+    const char* data = slot.data.get();
+    size_t left = slot.size;
+    while (left > 0 && error.load(std::memory_order_relaxed) == 0) {
+      const ssize_t n = write(fd, data, left);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        error = errno;
+        break;
+      }
+      data += n;
+      left -= n;
+    }
+    writeNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    bytesWritten += slot.size - left;
+    ++buffersWritten;
+
+    tail.store(current + 1, std::memory_order_release);
+    tail.notify_one();
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+#define WRITER_RING_SIZE 8
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+namespace SerialReader {
+  struct WriterStats {
+    size_t bytesWritten = 0;
+    size_t buffersWritten = 0;
+    size_t occupancy = 0;
+    size_t maxOccupancy = 0;
+    std::chrono::nanoseconds stallTime{0};
+    std::chrono::nanoseconds writeTime{0};
+    int error = 0;
+  };
+
+  /**
+   * Stream buffer which moves disk writes off the serial thread.
+   * The serial thread fills one large buffer at a time through the usual std::ostream interface. Full buffers are
+   * handed over through a bounded lock-free single-producer/single-consumer ring to a dedicated thread, which writes
+   * each of them with one write() call. The serial thread only ever blocks if all buffers of the ring are waiting
+   * for the disk, which is counted as stall time.
+   */
+  class AsyncWriter : public std::streambuf {
+  public:
+    explicit AsyncWriter(const std::string& path, size_t bufferSize = WRITER_BUFFER_SIZE,
+                         size_t ringSize = WRITER_RING_SIZE);
+
+    AsyncWriter(const AsyncWriter&) = delete;
+
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    ~AsyncWriter() override;
+
+    /**
+     * Hands over the partially filled buffer, waits until everything is on disk and closes the file.
+     */
+    void close();
+
+    [[nodiscard]] bool isOpen() const {
+      return fd >= 0;
+    }
+
+    [[nodiscard]] const std::string& getPath() const {
+      return path;
+    }
+
+    /**
+     * Only to be called from the thread filling the buffers.
+     */
+    [[nodiscard]] WriterStats stats() const;
+
+  protected:
+    int_type overflow(int_type ch) override;
+
+    int sync() override;
+
+  private:
+    struct Slot {
+      std::unique_ptr<char[]> data;
+      size_t size = 0;
+    };
+
+    void publish();
+
+    void acquire();
+
+    void drain();
+
+    const std::string path;
+    const size_t bufferSize;
+    const size_t ringSize;
+    const std::unique_ptr<Slot[]> ring;
+
+    int fd;
+    bool closed = false;
+    std::thread writerThread;
+
+    // Slots [tail, head) are waiting to be written, head is the one being filled. An empty slot tells the writer
+    // thread to stop.
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+
+    size_t maxOccupancy = 0;
+    std::chrono::nanoseconds stallTime{0};
+    std::atomic<size_t> bytesWritten{0};
+    std::atomic<size_t> buffersWritten{0};
+    std::atomic<int64_t> writeNanos{0};
+    std::atomic<int> error{0};
+  };
+}
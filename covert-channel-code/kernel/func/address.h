@@ -24,6 +24,9 @@
  
     // Controls actuation of pull up/down to ALL GPIO pins.
 #define GPPUD (GPIO_BASE + 0x94)
+
+    // Function select for GPIO 10 - 19.
+#define GPFSEL1 (GPIO_BASE + 0x04)
  
     // Controls actuation of pull up/down for specific GPIO pin.
 #define GPPUDCLK0 (GPIO_BASE + 0x98)
@@ -51,6 +54,13 @@
 #define UART0_ITOP   (UART0_BASE + 0x88)
 #define UART0_TDR    (UART0_BASE + 0x8C)
 
+    // RTS/CTS on GPIO 17/16, has to match the GPU firmware.
+#define UART_FLOW_CONTROL 1
+ 
+    // Baud rate negotiation with the GPU, which owns the UART clock.
+#define UART_BAUD_REQUEST 0xBA000000 // | baud rate, instead of a mode
+#define DEFAULT_BAUD      115200
+
 #define TS_TSENSSTAT 0x00030006
 
         /* ARM Mailbox */
@@ -62,4 +72,18 @@
 #define ARM_0_MAIL1_WRT (ARM_SBM_OWN0 + 0xA0) /* Write ARM->VC4 */
 
 #define ARM_MS_EMPTY 0x40000000
-#define ARM_MS_FULL  0x80000000
\ No newline at end of file
+#define ARM_MS_FULL  0x80000000
+
+        /* Jobs of the GPU */
+#define PUF_JOB_DONE       0xD0000000 /* | mode, sent back once a job has been read out */
+#define PUF_JOB_MASK       0x00FFFFFF
+        /* Parameter block of a job, sent as its address | channel like a property buffer */
+#define PUF_PARAMS_CHANNEL 0x8
+#define PUF_PARAMS_MAGIC   0x50554650 /* "PUFP" */
+#define PUF_PARAMS_VERSION 1
+#define PUF_PARAMS_ACK     0xAC000000 /* | version, the GPU has taken the parameters */
+#define PUF_PARAMS_NAK     0xAD000000 /* | version the GPU expects */
+        /* One-line command instead of the menu: "!mode addmode funcloc start end init function interval decay" */
+#define MENU_COMMAND       -1
+#define COMMAND_SIZE       128
+#define COMMAND_FIELDS     9
\ No newline at end of file
@@ -132,6 +132,57 @@ int getfuncfreq() {
     return freq;
 }
 
+// get baud_rate, 0 keeps the default
+uint32_t getbaudrate() {
+    uint32_t baud = 0;
+    unsigned char temp;
+    while ((int) (temp = uart_getc()) != 13) {
+        if (48 <= temp && temp <= 57) {
+            uart_putc(temp);
+            baud = baud * 10 + (temp - 48);
+        }
+    }
+    uart_putc(temp);
+    return baud;
+}
+
+// choose mode from the menu (up to two digits), or MENU_COMMAND if a one-line command follows
+int get_menu() {
+    int mode = 0;
+    while (1) {
+        unsigned char temp = uart_getc();
+        if (temp == 13) {
+            uart_putc(temp);
+            return mode;
+        } else if (temp == '!') {
+            uart_putc(temp);
+            return MENU_COMMAND;
+        } else if (48 <= temp && temp <= 57) {
+            uart_putc(temp);
+            mode = (mode % 10) * 10 + (temp - 48);
+        }
+    }
+}
+
+// get one command line up to the carriage return, returns its length or -1 if it doesn't fit
+int getcommand(char *line, int size) {
+    int len = 0;
+    unsigned char temp;
+    while ((temp = uart_getc()) != 13) {
+        if (len < size - 1) {
+            uart_putc(temp);
+            line[len] = temp;
+        }
+        len++;
+    }
+    uart_putc(temp);
+    if (len >= size) {
+        return -1;
+    }
+    line[len] = 0;
+    return len;
+}
+
 // choose mode
 int get_mode() {
     int mode = 0;
@@ -166,149 +166,216 @@ void puf_read_itvl(uint32_t start_addr, uint32_t end_addr, uint32_t add_mode) {
 }
 
 
-/** 
- * Function: Test puf for all address segments from the start address you set
+/**
+ * Parameters of one job, read by the GPU in one go once the kernel has sent their address
  *
- * Set: puf_start_address, decay_time, CPU_function
+ * size lets later versions append fields, the GPU rejects blocks of another version.
+**/
+struct puf_params {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t mode;
+    uint32_t add_mode;
+    uint32_t func_loc;
+    uint32_t start_addr;
+    uint32_t end_addr;
+    uint32_t init_value;
+    uint32_t dcy_func;
+    uint32_t nfreq;
+    uint32_t decay_time;
+};
+
+// The low 4 bits of the address carry the channel. The MMU is off, so the block is in memory once it's written.
+static struct puf_params job_params __attribute__((aligned(16)));
+
+/**
+ * Function: Hand the job to the GPU and wait until it has taken the parameters
  *
- * P.S. puf_init_value = 0
+ * Returns 0 if the GPU rejected them.
+**/
+int SendParams(uint32_t mode) {
+    job_params.magic = PUF_PARAMS_MAGIC;
+    job_params.version = PUF_PARAMS_VERSION;
+    job_params.size = sizeof(job_params);
+    job_params.mode = mode;
+    mailbox_write((uint32_t) &job_params | PUF_PARAMS_CHANNEL);
+    uint32_t reply = mailbox_read();
+    if (reply == (PUF_PARAMS_ACK | PUF_PARAMS_VERSION)) {
+        return 1;
+    }
+    uart_puts("\r\nParameters rejected, the GPU expects version ");
+    print_int(reply & PUF_JOB_MASK, 3);
+    uart_puts("\r\n");
+    return 0;
+}
+
+/**
+ * Function: Ask for the parameters all memory tests share
 **/
-void TestAllAddress() {
+void ReadParams() {
     uart_puts("Choose address mode: 0:brc 1:rbc|: ");
-    int addmode = getaddmode();
-    mailbox_write(addmode);
-    delay_ms(50);
+    job_params.add_mode = getaddmode();
 
     uart_puts("Choose function running location: 0:CPU 1:GPU|: ");
-    int funcloc = getaddmode();
-    mailbox_write(funcloc);
-    delay_ms(50);
+    job_params.func_loc = getaddmode();
 
     uart_puts("Input 8-digit puf start address|: 0x");
-    int stradd = getaddress();
-    mailbox_write(stradd);
-    delay_ms(50);
+    job_params.start_addr = getaddress();
 
     uart_puts("Input 8-digit puf end address|: 0x");
-    int endadd = getaddress();
-    mailbox_write(endadd);
-    delay_ms(50);
+    job_params.end_addr = getaddress();
 
     uart_puts("Input Init value|: 0x");
-    mailbox_write(getinitvalue());
-    delay_ms(50);
+    job_params.init_value = getinitvalue();
 
     uart_puts(MENU_SELECT);
-    int dcyfunc = get_mode();
-    mailbox_write(dcyfunc);
-    delay_ms(50);
+    job_params.dcy_func = get_mode();
 
     uart_puts("Input function execution interval (freq=n*50us)|: ");
-    int nfreq = getfuncfreq();
-    mailbox_write(nfreq);
-    delay_ms(50);
+    job_params.nfreq = getfuncfreq();
 
     uart_puts("Input decay time(s)|: ");
-    int decaytime = getdecaytime();
-    mailbox_write(decaytime);
-    delay_ms(50);
-
-    delay_s(decaytime);
+    job_params.decay_time = getdecaytime();
 }
 
-/** 
- * Function: Test puf of contiguous address segment
+/**
+ * Function: Parse the next number of a command line into value
  *
- * Set: puf_start_address, puf_init_value, puf_size, decay_time, CPU_function
+ * Returns the rest of the line, or 0 if the field holds anything but digits of the base.
 **/
-void TestPuf() {
-    uart_puts("Choose address mode: 0:brc 1:rbc|: ");
-    int addmode = getaddmode();
-    mailbox_write(addmode);
-    delay_ms(50);
-
-    uart_puts("Choose function running location: 0:CPU 1:GPU|: ");
-    int funcloc = getaddmode();
-    mailbox_write(funcloc);
-    delay_ms(50);
-
-    uart_puts("Input 8-digit puf start address|: 0x");
-    int stradd = getaddress();
-    mailbox_write(stradd);
-    delay_ms(50);
+const char* ParseField(const char* s, uint32_t base, uint32_t* value, int* digits) {
+    while (*s == ' ') {
+        s++;
+    }
+    *value = 0;
+    *digits = 0;
+    for (;; s++) {
+        uint32_t d;
+        if (*s >= '0' && *s <= '9') {
+            d = *s - '0';
+        } else if (base == 16 && *s >= 'a' && *s <= 'f') {
+            d = *s - 'a' + 10;
+        } else if (base == 16 && *s >= 'A' && *s <= 'F') {
+            d = *s - 'A' + 10;
+        } else {
+            break;
+        }
+        *value = *value * base + d;
+        (*digits)++;
+    }
+    return *s == ' ' || *s == 0 ? s : 0;
+}
 
-    uart_puts("Input 8-digit puf end address|: 0x");
-    int endadd = getaddress();
-    mailbox_write(endadd);
-    delay_ms(50);
+int RejectCommand(const char* reason) {
+    uart_puts("\r\nCommand rejected: ");
+    uart_puts(reason);
+    uart_puts("\r\n");
+    return -1;
+}
 
-    uart_puts("Input Init value|: 0x");
-    mailbox_write(getinitvalue());
-    delay_ms(50);
+/**
+ * Function: Read a one-line command and check all of its fields before anything is sent to the GPU
+ *
+ * Fields: mode, address mode, function location, start address, end address (hex, left aligned like at the
+ * prompts), init value (hex), function, interval, decay time. Returns the mode, or -1 if the command is rejected.
+**/
+int ReadCommand() {
+    static const char* names[COMMAND_FIELDS] = {"mode", "address mode", "function location", "start address",
+                                                "end address", "init value", "function", "interval", "decay time"};
+    char line[COMMAND_SIZE];
+    uint32_t field[COMMAND_FIELDS];
+    int digits[COMMAND_FIELDS];
+    if (getcommand(line, sizeof(line)) < 0) {
+        return RejectCommand("too long");
+    }
+    const char* s = line;
+    for (int i = 0; i < COMMAND_FIELDS; i++) {
+        int hex = i >= 3 && i <= 5;
+        s = ParseField(s, hex ? 16 : 10, &field[i], &digits[i]);
+        if (s == 0 || digits[i] == 0 || digits[i] > (hex ? 8 : 9)) {
+            return RejectCommand(names[i]);
+        }
+    }
+    while (*s == ' ') {
+        s++;
+    }
+    if (*s != 0) {
+        return RejectCommand("too many fields");
+    }
+    for (int i = 3; i <= 4; i++) {
+        field[i] *= pow(16, 8 - digits[i]);
+    }
 
-    uart_puts(MENU_SELECT);
-    int dcyfunc = get_mode();
-    mailbox_write(dcyfunc);
-    delay_ms(50);
+    // Mode 4 is the preset of the menu, it has no parameters
+    if (field[0] > 11 || field[0] == 4) {
+        return RejectCommand(names[0]);
+    }
+    for (int i = 1; i <= 2; i++) {
+        if (field[i] > 1) {
+            return RejectCommand(names[i]);
+        }
+    }
+    for (int i = 3; i <= 4; i++) {
+        if (field[i] < 0xC3000000 || field[i] > 0xDFFFFFFF) {
+            return RejectCommand(names[i]);
+        }
+    }
+    if (field[4] <= field[3]) {
+        return RejectCommand(names[4]);
+    }
+    if (field[6] > 5) {
+        return RejectCommand(names[6]);
+    }
 
-    uart_puts("Input function execution interval (freq=n*50us)|: ");
-    int nfreq = getfuncfreq();
-    mailbox_write(nfreq);
-    delay_ms(50);
+    job_params.add_mode = field[1];
+    job_params.func_loc = field[2];
+    job_params.start_addr = field[3];
+    job_params.end_addr = field[4];
+    job_params.init_value = field[5];
+    job_params.dcy_func = field[6];
+    job_params.nfreq = field[7];
+    job_params.decay_time = field[8];
+    uart_puts("\r\n");
+    return field[0];
+}
 
-    uart_puts("Input decay time(s)|: ");
-    int decaytime = getdecaytime();
-    mailbox_write(decaytime);
-    delay_ms(50);
+/** 
+ * Function: Test puf for all address segments from the start address you set
+ *
+ * Set: puf_start_address, decay_time, CPU_function
+ *
+ * P.S. puf_init_value = 0
+**/
+int TestAllAddress(uint32_t mode) {
+    ReadParams();
+    return SendParams(mode);
+}
 
-    delay_s(decaytime);
+/** 
+ * Function: Test puf of contiguous address segment
+ *
+ * Set: puf_start_address, puf_init_value, puf_size, decay_time, CPU_function
+**/
+int TestPuf(uint32_t mode) {
+    ReadParams();
+    return SendParams(mode);
 }
 
 /**
  * Function: Test puf of contiguous address segment with pre-written args
 **/
-void TestCustom() {
+int TestCustom(uint32_t mode) {
     uart_puts("Starting custom extractor...");
-    //uart_puts("Choose address mode: 0:brc 1:rbc|: ");
-    int addmode = 0;
-    mailbox_write(addmode);
-    delay_ms(50);
-
-    //uart_puts("Choose function running location: 0:CPU 1:GPU|: ");
-    int funcloc = 0;
-    mailbox_write(funcloc);
-    delay_ms(50);
-
-    //uart_puts("Input 8-digit puf start address|: 0x");
-    int stradd = 0xC3000000;
-    mailbox_write(stradd);
-    delay_ms(50);
-
-    //uart_puts("Input 8-digit puf end address|: 0x");
-    int endadd = 0xC4000000;
-    mailbox_write(endadd);
-    delay_ms(50);
-
-    //uart_puts("Input Init value|: 0x");
-    mailbox_write(0x00000000);
-    delay_ms(50);
-
-    //uart_puts(MENU_SELECT);
-    int dcyfunc = 1;
-    mailbox_write(dcyfunc);
-    delay_ms(50);
-
-    //uart_puts("Input function execution interval (freq=n*50us)|: ");
-    int nfreq = 1;
-    mailbox_write(nfreq);
-    delay_ms(50);
-
-    //uart_puts("Input decay time(s)|: ");
-    int decaytime = 600;
-    mailbox_write(decaytime);
-    delay_ms(50);
-
-    delay_s(decaytime);
+    job_params.add_mode = 0;
+    job_params.func_loc = 0;
+    job_params.start_addr = 0xC3000000;
+    job_params.end_addr = 0xC4000000;
+    job_params.init_value = 0x00000000;
+    job_params.dcy_func = 1;
+    job_params.nfreq = 1;
+    job_params.decay_time = 600;
+    return SendParams(mode);
 }
 
 /** 
@@ -318,47 +385,9 @@ void TestCustom() {
  *
  * P.S. puf_size=1024*4byte(32bit, 1 row)
 **/
-void TestOneRow() {
-    uart_puts("Choose address mode: 0:brc 1:rbc|: ");
-    int addmode = getaddmode();
-    mailbox_write(addmode);
-    delay_ms(50);
-
-    uart_puts("Choose function running location: 0:CPU 1:GPU|: ");
-    int funcloc = getaddmode();
-    mailbox_write(funcloc);
-    delay_ms(50);
-
-    uart_puts("Input 8-digit puf start address|: 0x");
-    int stradd = getaddress();
-    mailbox_write(stradd);
-    delay_ms(50);
-
-    uart_puts("Input 8-digit puf end address|: 0x");
-    int endadd = getaddress();
-    mailbox_write(endadd);
-    delay_ms(50);
-
-    uart_puts("Input Init value|: 0x");
-    mailbox_write(getinitvalue());
-    delay_ms(50);
-
-    uart_puts(MENU_SELECT);
-    int dcyfunc = get_mode();
-    mailbox_write(dcyfunc);
-    delay_ms(50);
-
-    uart_puts("Input function execution interval (freq=n*50us)|: ");
-    int nfreq = getfuncfreq();
-    mailbox_write(nfreq);
-    delay_ms(50);
-
-    uart_puts("Input decay time(s)|: ");
-    int decaytime = getdecaytime();
-    mailbox_write(decaytime);
-    delay_ms(50);
-
-    delay_s(decaytime);
+int TestOneRow(uint32_t mode) {
+    ReadParams();
+    return SendParams(mode);
 }
 
 /** 
@@ -368,47 +397,9 @@ void TestOneRow() {
  *
  * P.S. Test one row for each interval
 **/
-void TestAtInterval() {
-    uart_puts("Choose address mode: 0:brc 1:rbc|: ");
-    int addmode = getaddmode();
-    mailbox_write(addmode);
-    delay_ms(50);
-
-    uart_puts("Choose function running location: 0:CPU 1:GPU|: ");
-    int funcloc = getaddmode();
-    mailbox_write(funcloc);
-    delay_ms(50);
-
-    uart_puts("Input 8-digit puf start address|: 0x");
-    int stradd = getaddress();
-    mailbox_write(stradd);
-    delay_ms(50);
-
-    uart_puts("Input 8-digit puf end address|: 0x");
-    int endadd = getaddress();
-    mailbox_write(endadd);
-    delay_ms(50);
-
-    uart_puts("Input Init value|: 0x");
-    mailbox_write(getinitvalue());
-    delay_ms(50);
-
-    uart_puts(MENU_SELECT);
-    int dcyfunc = get_mode();
-    mailbox_write(dcyfunc);
-    delay_ms(50);
-
-    uart_puts("Input function execution interval (freq=n*50us)|: ");
-    int nfreq = getfuncfreq();
-    mailbox_write(nfreq);
-    delay_ms(50);
-
-    uart_puts("Input decay time(s)|: ");
-    int decaytime = getdecaytime();
-    mailbox_write(decaytime);
-    delay_ms(50);
-
-    delay_s(decaytime);
+int TestAtInterval(uint32_t mode) {
+    ReadParams();
+    return SendParams(mode);
 
     //puf_read_itvl(stradd, endadd, addmode);
 }
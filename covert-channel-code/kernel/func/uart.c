@@ -48,6 +48,19 @@ void uart_init()
  
 	// Write 0 to GPPUDCLK0 to make it take effect.
 	mmio_write(GPPUDCLK0, 0x00000000);
+
+#if UART_FLOW_CONTROL
+	// Route CTS0/RTS0 to GPIO 16/17 (ALT3).
+	mmio_write(GPFSEL1, (mmio_read(GPFSEL1) & ~((7 << 18) | (7 << 21))) | (7 << 18) | (7 << 21));
+
+	// Pull CTS down, so an unconnected CTS doesn't stop the transmitter.
+	mmio_write(GPPUD, 0x00000001);
+	delay(150);
+	mmio_write(GPPUDCLK0, (1 << 16));
+	delay(150);
+	mmio_write(GPPUDCLK0, 0x00000000);
+	mmio_write(GPPUD, 0x00000000);
+#endif
  
 	// Clear pending interrupts.
 	mmio_write(UART0_ICR, 0x7FF);
@@ -70,7 +83,12 @@ void uart_init()
 	                       (1 << 7) | (1 << 8) | (1 << 9) | (1 << 10));
  
 	// Enable UART0, receive & transfer part of UART.
+#if UART_FLOW_CONTROL
+	// Hardware flow control: RTSEN & CTSEN.
+	mmio_write(UART0_CR, (1 << 0) | (1 << 8) | (1 << 9) | (1 << 14) | (1 << 15));
+#else
 	mmio_write(UART0_CR, (1 << 0) | (1 << 8) | (1 << 9));
+#endif
 }
 
 // UART shows an unsigned char
@@ -81,6 +99,12 @@ void uart_putc(unsigned char c)
 	mmio_write(UART0_DR, c);
 }
 
+// Wait until everything queued has left the UART
+void uart_flush()
+{
+    while ( mmio_read(UART0_FR) & (1 << 3) ) { }
+}
+
 // UART shows a string
 void uart_puts(const char* str)
 {
@@ -105,3 +129,14 @@ unsigned char uart_getc()
 	}
     return mmio_read(UART0_DR);
 }
+
+// UART gets an input character, or -1 if nothing arrives within the given microseconds
+int uart_getc_timeout(uint32_t us)
+{
+    uint32_t start = ST_CLO;
+    while ( mmio_read(UART0_FR) & (1 << 4) ) {
+        if ((ST_CLO - start) > us)
+            return -1;
+    }
+    return mmio_read(UART0_DR) & 0xFF;
+}
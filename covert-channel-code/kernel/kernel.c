@@ -31,9 +31,98 @@
 extern "C" /* Use C linkage for kernel_main. */
 #endif
 
-void sendFlag(uint32_t flag) {
-    mailbox_write(flag);
-    delay_ms(50);
+// How long the host has to confirm a new baud rate, and how long it waits before giving up on it
+#define BAUD_CHECK_MS 1000
+// Time for the host to switch before the first byte at the new rate
+#define BAUD_SETTLE_MS 100
+
+/**
+ * Function: Let the host choose the baud rate for the rest of the session
+ *
+ * The GPU switches the UART right after the new rate is announced. If it can't generate the rate, or the host
+ * doesn't answer the check prompt at the new rate, both sides go back to 115200.
+**/
+void NegotiateBaud() {
+    uart_puts("Baud rate|: ");
+    uint32_t baud = getbaudrate() & 0x00FFFFFF;
+    if (baud == 0 || baud == DEFAULT_BAUD) {
+        uart_puts("\n");
+        return;
+    }
+    uart_puts("\nBaud ");
+    print_int(baud, 7);
+    uart_puts("\r\n");
+    uart_flush();
+    mailbox_write(UART_BAUD_REQUEST | baud);
+    if (mailbox_read() == baud) {
+        delay_ms(BAUD_SETTLE_MS);
+        uart_puts("Baud check|: ");
+        int c;
+        while ((c = uart_getc_timeout(BAUD_CHECK_MS * 1000)) >= 0 && c != 13) { }
+        if (c == 13) {
+            uart_puts("\r\n");
+            return;
+        }
+        uart_flush();
+        mailbox_write(UART_BAUD_REQUEST | DEFAULT_BAUD);
+        mailbox_read();
+    }
+    // Give the host time to notice and switch back as well
+    delay_ms(BAUD_CHECK_MS);
+    uart_puts("\r\nBaud ");
+    print_int(DEFAULT_BAUD, 7);
+    uart_puts("\r\n");
+}
+
+/**
+ * Function: Let the host choose the next job from the menu and hand it to the GPU
+ *
+ * Returns 0 if the mode is unknown or the GPU rejected the parameters, the menu is then shown again.
+**/
+int RunJob() {
+    uart_puts("Choose mode:\r\n 0: memory dump (bit)\r\n 1: test all addresses (cell)\r\n 2: test all addresses (bitflip summary)\r\n 3: extract at interval\r\n 4: test params from kernel\r\n 5: memory dump (sparse)\r\n 6: memory dump (compressed)\r\n 7: stable bits (key)\r\n 8: staggered readout\r\n 9: memory dump (PASR decay)\r\n 10: memory dump (adaptive decay)\r\n 11: flip statistics\r\n !: one-line command|: ");
+    int input = get_menu();
+    if (input == MENU_COMMAND) {
+        int mode = ReadCommand();
+        return mode >= 0 && SendParams(mode);
+    }
+    switch(input) {
+        case 0:
+            return TestAllAddress(0);
+        case 1:
+            return TestPuf(1);
+        case 2:
+            return TestOneRow(2);
+        case 3:
+            return TestAtInterval(3);
+        case 4:
+            return TestCustom(0);
+        case 5:
+            return TestAllAddress(5);
+        case 6:
+            return TestAllAddress(6);
+        case 7:
+            return TestAllAddress(7);
+        case 8:
+            return TestAllAddress(8);
+        case 9:
+            return TestAllAddress(9);
+        case 10:
+            return TestAllAddress(10);
+        case 11:
+            return TestAllAddress(11);
+        default:
+            // The GPU would wait for the parameters of a mode it doesn't know forever
+            uart_puts("\r\nUnknown mode\r\n");
+            return 0;
+    }
+}
+
+/**
+ * Function: Wait until the GPU has read out the job and turned refresh back on
+**/
+void WaitJob() {
+    while ((mailbox_read() & ~PUF_JOB_MASK) != PUF_JOB_DONE) { }
 }
 
 void kernel_main(uint32_t r0, uint32_t r1, uint32_t atags) {
@@ -47,37 +136,16 @@ void kernel_main(uint32_t r0, uint32_t r1, uint32_t atags) {
     uart_putc(0x16);
     uart_putc(0x16);
     delay_s(10);
-    uart_putc(0x16);
-    uart_putc(0x16);
-    uart_putc(0x16);
-    uart_puts("$|Choose mode:\r\n 0: memory dump (bit)\r\n 1: test all addresses (cell)\r\n 2: test all addresses (bitflip summary)\r\n 3: extract at interval\r\n 4: test params from kernel|: ");
-    int input = get_mode();
-    switch(input) {
-        case 0:
-            sendFlag(0);
-            TestAllAddress();
-            break;
-        case 1:
-            sendFlag(1);
-            TestPuf();
-            break;
-        case 2:
-            sendFlag(2);
-            TestOneRow();
-            break;
-        case 3:
-            sendFlag(3);
-            TestAtInterval();
-            break;
-        case 4:
-            sendFlag(0);
-            TestCustom();
-            break;
-        default:
-            sendFlag(input);
-            TestPuf();
-            break;
+    // Jobs run back to back until the host power cycles the board, each one announced like the first after boot
+    for (int job = 0; ; job++) {
+        uart_putc(0x16);
+        uart_putc(0x16);
+        uart_putc(0x16);
+        uart_puts("$|");
+        if (job == 0) {
+            NegotiateBaud();
+        }
+        while (!RunJob()) { }
+        WaitJob();
     }
-    while (1) { /* wait */ }
-    uart_putc(0x18);
 }
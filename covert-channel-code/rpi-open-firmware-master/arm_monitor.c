@@ -25,53 +25,80 @@ First stage monitor.
 
 #define logf(fmt, ...) printf("[SDRAM:%s]: " fmt, __FUNCTION__, ##__VA_ARGS__);
 
+// Sent by the kernel instead of a mode to switch the UART, the lower bits carry the baud rate
+#define UART_BAUD_REQUEST 0xBA000000
+#define UART_BAUD_MASK    0x00FFFFFF
+// Sent back to the kernel once a job has been read out, the lower bits carry the mode
+#define PUF_JOB_DONE      0xD0000000
+
+extern unsigned int uart_set_baud(unsigned int baud);
+
+// Parameter block of a job (see SendParams in kernel/func/test.c), sent as its ARM address | channel
+#define PUF_PARAMS_CHANNEL 0x8
+#define PUF_PARAMS_MAGIC   0x50554650
+#define PUF_PARAMS_VERSION 1
+#define PUF_PARAMS_ACK     0xAC000000
+#define PUF_PARAMS_NAK     0xAD000000
+
+struct puf_params {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t mode;
+	uint32_t add_mode;
+	uint32_t func_loc;
+	uint32_t start_addr;
+	uint32_t end_addr;
+	uint32_t init_value;
+	uint32_t dcy_func;
+	uint32_t nfreq;
+	uint32_t decay_time;
+};
+
 volatile unsigned int addmode, bank, row, col, mode, address, funcloc, dcyfunc, nfreq;
 volatile unsigned int stradd, endadd, initvalue, pufsize, decaytime, cputemp, interval;
 
-int get_mode()
+// Mode of the job taken by sleh_irq, -1 while there is none
+volatile int g_PendingJob = -1;
+
+// Name of every mode, as print_params shows it
+static const char* const puf_mode_names[] = {
+	"Memory dump (bit)",
+	"Get All PUF (cell)",
+	"Get All PUF (bitflip)",
+	"Extract PUF at Intervals",
+	"Test parameters from kernel",
+	"Memory dump (sparse)",
+	"Memory dump (compressed)",
+	"Stable bits",
+	"Staggered readout",
+	"Memory dump (PASR decay)",
+	"Memory dump (adaptive decay)",
+	"Flip statistics",
+};
+
+#define PUF_MODES (sizeof(puf_mode_names)/sizeof(puf_mode_names[0]))
+
+void print_params()
 {
-	mode=ARM_1_MAIL1_RD;
-
-	switch (mode)
-	{
-		case  0: printf("\nMemory dump (bit)\n\n");
-				 break;
-		case  1: printf("\nGet All PUF (cell)\n\n");
-				 break;
-		case  2: printf("\nGet All PUF (bitflip)\n\n");
-				 break;
-		case  3: printf("\nExtract PUF at Intervals\n\n");
-				 break;
-		case  4: printf("\nTest parameters from kernel\n\n");
-				 break;
-		default: printf("\nUnknown value\n\n");
-				 break;
-	}
-	
-	return mode;
-}
+	if (mode < PUF_MODES)
+		printf("\n%s\n\n", puf_mode_names[mode]);
+	else
+		printf("\nUnknown value\n\n");
 
-void get_address_mode()
-{
-	addmode=ARM_1_MAIL1_RD;
 	if(addmode==0)
 		printf("\nAddress Mode = BRC\n\n");
 	else
 		printf("\nAddress Mode = RBC\n\n");
-}
 
-void get_func_loc()
-{
-	funcloc=ARM_1_MAIL1_RD;
 	if(funcloc==0)
 		printf("\nFunction run on CPU\n\n");
 	else
 		printf("\nFunction run on GPU\n\n");
-}
 
-void get_decay_func()
-{
-	dcyfunc=ARM_1_MAIL1_RD;
+	printf("\nPUF start address = 0x%08X\n\n",stradd);
+	printf("\nPUF end address = 0x%08X\n\n",endadd);
+	printf("\nPUF init value = 0x%08X\n\n",initvalue);
 
 	switch (dcyfunc)
 	{
@@ -90,13 +117,60 @@ void get_decay_func()
 		default: printf("\nNo operation\n\n");
 				 break;
 	}
-}
-void get_func_freq()
-{
-	nfreq=ARM_1_MAIL1_RD;
 	printf("\nFunction execution interval = %d us\n\n", (nfreq*50));
+	printf("\ndecaytime = %d s\n\n",decaytime);
 }
 
+/**
+ * Description: Takes the next message of the kernel, a baud rate request or the parameter block of a job
+ * Output: The mode of the job to run, or -1
+**/
+int get_job()
+{
+	if (ARM_1_MAIL1_STA & ARM_MS_EMPTY)
+		return -1;
+
+	uint32_t msg=ARM_1_MAIL1_RD;
+
+	if ((msg & ~UART_BAUD_MASK) == UART_BAUD_REQUEST) {
+		// The kernel waits for the rate actually in use before it prints anything again
+		ARM_1_MAIL0_WRT = uart_set_baud(msg & UART_BAUD_MASK);
+		return -1;
+	}
+	if ((msg & 0xF) != PUF_PARAMS_CHANNEL) {
+		printf("\nUnknown message 0x%08X\n\n", msg);
+		return -1;
+	}
+
+	// The kernel runs without caches, the uncached alias sees what it has written
+	const volatile struct puf_params* p = (const volatile struct puf_params*)(0xC0000000 | (msg & ~0xF));
+	if (p->magic != PUF_PARAMS_MAGIC || p->version != PUF_PARAMS_VERSION || p->size < sizeof(struct puf_params)) {
+		printf("\nParameter block version %d, expected %d\n\n", p->version, PUF_PARAMS_VERSION);
+		ARM_1_MAIL0_WRT = PUF_PARAMS_NAK | PUF_PARAMS_VERSION;
+		return -1;
+	}
+	if (p->start_addr < 0xC3000000 || p->start_addr > 0xDFFFFFFF ||
+	    p->end_addr < 0xC3000000 || p->end_addr > 0xDFFFFFFF) {
+		panic("Address must be between C3000000 and DFFFFFFF");
+	}
+	if (p->end_addr <= p->start_addr) {
+		panic("End address must be greater than start address");
+	}
+
+	mode=p->mode;
+	addmode=p->add_mode;
+	funcloc=p->func_loc;
+	stradd=p->start_addr;
+	endadd=p->end_addr;
+	initvalue=p->init_value;
+	dcyfunc=p->dcy_func;
+	nfreq=p->nfreq;
+	decaytime=p->decay_time;
+	ARM_1_MAIL0_WRT = PUF_PARAMS_ACK | PUF_PARAMS_VERSION;
+
+	print_params();
+	return mode;
+}
 
 void cpu_code()
 {
@@ -122,52 +196,33 @@ void cpu_code()
 	}
 }
 
-void get_start_address()
-{
-	stradd=ARM_1_MAIL1_RD;
-	if (stradd < 0xC3000000 || stradd > 0xDFFFFFFF) {
-		panic("Address must be between C3000000 and DFFFFFFF");
-	}
-	printf("\nPUF start address = 0x%08X\n\n",stradd);
-}
-
-void get_end_address()
-{
-	endadd=ARM_1_MAIL1_RD;
-	if (endadd < 0xC3000000 || endadd > 0xDFFFFFFF) {
-		panic("Address must be between C3000000 and DFFFFFFF");
-	}
-	if (endadd <= stradd) {
-		panic("End address must be greater than start address");
-	}
-	printf("\nPUF end address = 0x%08X\n\n",endadd);
-}
-
-void get_init_value()
-{
-	initvalue=ARM_1_MAIL1_RD;
-	printf("\nPUF init value = 0x%08X\n\n",initvalue);
-}
-
-void get_decay_time()
-{
-	decaytime=ARM_1_MAIL1_RD;
-	printf("\ndecaytime = %d s\n\n",decaytime);
-}
+typedef void (*puf_job)(unsigned long, unsigned long, unsigned long, int, int, int, int, int);
+
+// Test of every mode, mode 4 runs cpu_code instead
+static const puf_job puf_jobs[PUF_MODES] = {
+	puf_extract_all,
+	puf_extracted,
+	puf_extract_brc,
+	puf_extract_itvl,
+	0,
+	puf_extract_sparse,
+	puf_extract_rle,
+	puf_extract_bits,
+	puf_extract_stages,
+	puf_extract_pasr,
+	puf_extract_adaptive,
+	puf_extract_stats,
+};
 
 void execute_puf(int mode)
 {
-	if (mode==0) {
-		puf_extract_all(stradd, endadd, initvalue, decaytime, addmode, funcloc, dcyfunc, nfreq);	
-	} else if (mode==1) {
-		puf_extracted(stradd, endadd, initvalue, decaytime, addmode, funcloc, dcyfunc, nfreq);
-	} else if (mode==2) {
-		puf_extract_brc(stradd, endadd, initvalue, decaytime, addmode, funcloc, dcyfunc, nfreq);
-	} else if (mode==3) {
-		puf_extract_itvl(stradd,endadd,initvalue,decaytime, addmode, funcloc, dcyfunc, nfreq);
-	} else if (mode==4) {
+	if (mode==4) {
 		cpu_code();
+	} else if (mode>=0 && mode<(int)PUF_MODES) {
+		puf_jobs[mode](stradd, endadd, initvalue, decaytime, addmode, funcloc, dcyfunc, nfreq);
 	}
+	// Refresh is back on, the kernel may set up the next job of the batch
+	ARM_1_MAIL0_WRT = PUF_JOB_DONE | mode;
 	//reboot();
 }
 
@@ -175,11 +230,20 @@ void monitor_start()
 {
 	printf("Starting IPC monitor ...\n");
 
+	/* second VPU core for the readouts */
+	pipe_start();
+
 	/* enable IRQ */
 	ARM_1_MAIL1_CNF = ARM_MC_IHAVEDATAIRQEN;
 
 	for(;;) {
 		__asm__ __volatile__ ("sleep" :::);
 		// printf("sleep interrupted!\n");
+
+		int job = g_PendingJob;
+		if (job >= 0) {
+			g_PendingJob = -1;
+			execute_puf(job);
+		}
 	}
 }
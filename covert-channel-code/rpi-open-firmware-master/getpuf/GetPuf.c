@@ -2,30 +2,21 @@
 #include "hardware.h"
 #include "PufAddress.h"
 #include "function.c"
+#include "pipe.c"
+#include "chunk.c"
+#include "sched.c"
+#include "phase.c"
+#include "window.c"
+#include "pasr.c"
 
 extern void timing_init();
+extern uint32_t _end;
 
 #define logf(fmt, ...) printf("[SDRAM:%s]: " fmt, __FUNCTION__, ##__VA_ARGS__);
 
-/**
- * Description: Manually refresh address segments stored with code
- * during the decay time
- *
- * Input: decay_time
-**/
-unsigned long MRList[]={
-	0xc0023000,
-	0xc0024000,
-	0xc0123000,
-	0xc0172000,
-	0xc2000000,
-	0xc2001000,
-
-};
-
 int inArray(unsigned long a)
 {
-	int length = sizeof(MRList)/4;
+	int length = PUF_MR_ROWS;
 	for (int i=0; i<length; i++)
 	{
 		if(a==MRList[i])
@@ -53,7 +44,7 @@ void GPUfunc(int dcy_func)
 }
 void Refresh()
 {
-	int length=sizeof(MRList)/4;
+	int length=PUF_MR_ROWS;
 	unsigned long temp=0xc0000000;
 	unsigned int t;
 	for(int j=0;j<15;j++)
@@ -80,94 +71,28 @@ void Refresh()
 		t=mmio_read32(temp);
 		temp=temp+0x1000;
 	}
+
+	temp=PUF_WORK_POS;
+	for(int j=0;j<PUF_WORK_POS_SIZE/0x1000;j++)
+	{
+		t=mmio_read32(temp);
+		temp=temp+0x1000;
+	}
 }
 
 
+/**
+ * Description: Decay for decay_time seconds with refresh disabled, keeping the code rows alive from the timer
+ * interrupt (see sched.c). dcy_func runs every nfreq * 50 us, back to back if nfreq is 0.
+ *
+ * Input: decay_time, dcy_func, nfreq
+**/
 void ManuallyRefresh(int decay_time,int dcy_func,int nfreq)
-{	
-	int freq_func=nfreq;			// func_freq=n*50us
-	int ftp=0;
-	int mtp=0;
-	uint32_t ufunc_t=0;
-	int function_count=0;
-	if(dcy_func!=0)
-	{
-		for(int tp=0;tp<=decay_time*20000;)
-		{
-			if(freq_func==0)
-			{
-				while(1)
-				{
-					__asm__ __volatile__ ("nop" :::);
-					uint32_t tin=ST_CLO;
-					
-					GPUfunc(dcy_func);
-					ufunc_t=ST_CLO-tin;
-					uint32_t func_t=ufunc_t/50;
-					function_count+=1;
-					mtp+=func_t;
-					tp+=func_t;
-					if(mtp>=1280)
-					{
-						Refresh();
-						mtp=0;
-					}
-					if(tp>decay_time*20000)
-						break;
-				}
-			}
-			else
-			{
-				ftp+=1;
-				mtp+=1;
-				tp+=1;
-				udelay(50);
-				if(ftp==freq_func)
-				{
-					__asm__ __volatile__ ("nop" :::);
-					uint32_t tin=ST_CLO;
-					
-					GPUfunc(dcy_func);
-					ufunc_t=ST_CLO-tin;
-					uint32_t func_t=ufunc_t/50;
-					function_count+=1;
-					ftp=0;
-					tp+=func_t;
-					mtp+=func_t;
-					if(mtp>=1280)
-					{
-						Refresh();
-						mtp=0;
-					}
-				}
-				if(mtp>=1280)
-				{
-					Refresh();
-					mtp=0;
-				}
-			}
-		}
-	}
-	else
-	{
-		for(int tp=0;tp<=decay_time*1000;)
-		{
-			delay_ms(1);
-			tp+=1;
-			if(tp%64==0)
-			{
-				Refresh();
-			}
-		}
-	}
-	
-	
-	if(function_count!=0)
-	{
-		printf("function_count = %d\n",function_count );
-		printf("function time = %d us\n",ufunc_t);
-	}
-	
+{
+	sched_start(ST_CLO, dcy_func!=0 ? nfreq*50 : 0);
+	sched_wait(decay_time*1000000, dcy_func, 0);
+	sched_stop();
+
 	printf("Manually refresh");
 }
 
@@ -187,6 +112,96 @@ unsigned long cal(unsigned long x)
     return n;
 }
 
+/**
+ * Description: Bank and row of an address
+ *
+ * Input: addr, add_mode, bank, row
+**/
+void puf_decode_row(unsigned long addr, unsigned int add_mode, uint32_t* bank, uint32_t* row)
+{
+	if (add_mode==0)
+	{
+		*bank=(0x1c000000&addr)>>26;
+		*row=(0x03fff000&addr)>>12;
+	}
+	else
+	{
+		*row=(0x1fff8000&addr)>>15;
+		*bank=(0x00007000&addr)>>12;
+	}
+}
+
+/**
+ * Description: Start a readout with the SYN bytes, "&|" and the bank, row and column of its first cell,
+ * the caller adds the rest of the header
+ *
+ * Input: start_addr, add_mode
+**/
+void puf_header(unsigned long start_addr, unsigned int add_mode)
+{
+	uint32_t bank, row;
+	puf_decode_row(start_addr, add_mode, &bank, &row);
+	putchar(0x16); // SYN
+	putchar(0x16); // SYN
+	putchar(0x16); // SYN
+    printf("&|");
+    printf("%d%04X%03X", bank, row, (0x00000ffc&start_addr)>>2);
+}
+
+/**
+ * Description: End the chunks of a readout with the number of its cells, then send the chunks the host
+ * asks for again (see chunk_resend)
+ *
+ * Input: cells, start_addr, end_addr, init_value, encode
+**/
+void puf_footer(uint32_t cells, unsigned long start_addr, unsigned long end_addr, unsigned int init_value, puf_encoder encode)
+{
+	phase_end("transmit");
+    printf("|&%d\n",cells);
+	chunk_resend(start_addr, end_addr, init_value, encode);
+	phase_end("resend");
+}
+
+/**
+ * Description: Finish a readout with the phases trailer and "|$"
+**/
+void puf_close()
+{
+	phase_trailer();
+    printf("|$\n");
+    delay_ms(100);
+}
+
+/**
+ * Description: Turn off the auto refresh of the SDRAM, timing_init turns it on again
+**/
+void puf_refresh_off()
+{
+	printf("disable Refresh\n");
+	SD_SA =
+	    (0 << SD_SA_RFSH_T_LSB)
+	    | SD_SA_PGEHLDE_SET
+	    | SD_SA_CLKSTOP_SET
+	    | SD_SA_POWSAVE_SET
+	    | 0x3214;
+}
+
+/**
+ * Description: Let the cells decay without auto refresh, the code rows refreshed by hand
+ *
+ * Input: decay_time, func_loc, dcy_func, nfreq
+**/
+void puf_decay(int decay_time, int func_loc, int dcy_func, int nfreq)
+{
+	puf_refresh_off();
+	if(func_loc)
+		ManuallyRefresh(decay_time, dcy_func, nfreq);
+	else
+		ManuallyRefresh(decay_time, 0, 0);
+	printf("decay completed\n");
+	phase_end("decay");
+}
+
 /**
  * Description: Write the initial value of puf 
  * to the specified address segment
@@ -211,6 +226,30 @@ void puf_init(unsigned long addr,unsigned int puf_size, unsigned int init_value)
 	printf("puf init complete\n");
 }
 
+/**
+ * Description: Write value to every word of [start, end), eight stores per loop
+ * Input: start, end, value
+**/
+void puf_fill(unsigned long start, unsigned long end, unsigned int value)
+{
+	volatile unsigned int* p = (volatile unsigned int*)start;
+	volatile unsigned int* stop = (volatile unsigned int*)end;
+	while (stop - p >= 8)
+	{
+		p[0] = value;
+		p[1] = value;
+		p[2] = value;
+		p[3] = value;
+		p[4] = value;
+		p[5] = value;
+		p[6] = value;
+		p[7] = value;
+		p += 8;
+	}
+	while (p < stop)
+		*p++ = value;
+}
+
 /**
  * Description: Write the initial value of puf 
  * to the specified address segment
@@ -219,19 +258,37 @@ void puf_init(unsigned long addr,unsigned int puf_size, unsigned int init_value)
 **/
 void puf_init_all(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
 {
-	unsigned long addr;
-	for(addr=start_addr; addr<=end_addr; addr+=4)
+	struct puf_segment seg[PUF_MAX_SEGMENTS];
+	int n = puf_segments(start_addr, end_addr, seg);
+	unsigned long bytes = 0;
+	uint32_t tin = ST_CLO;
+	for (int i = 0; i < n; i++)
 	{
-		if ((addr>=0xc3000000&&addr<=0xcf000000)||(addr>=0xd0000000&&addr<0xe0000000))
-		{
-			if(inArray(addr))
-				addr+=0x1000;
-			else
-			{
-				mmio_write32(addr,init_value);
-			}
-		}
+		puf_fill(seg[i].start, seg[i].end, init_value);
+		bytes += seg[i].end - seg[i].start;
 	}
+	uint32_t init_t = ST_CLO - tin;
+	printf("%d bytes in %d segments initialised in %d ms\n", bytes, n, init_t / 1000);
+}
+
+/**
+ * Description: Initialise the range, let it decay (see puf_decay) and turn refresh on again
+ *
+ * Input: start_addr, end_addr, init_value, decay_time, func_loc, dcy_func, nfreq
+**/
+void puf_init_decay(unsigned long start_addr, unsigned long end_addr, unsigned int init_value, int decay_time, int func_loc, int dcy_func, int nfreq)
+{
+	/* PUF Init */
+	puf_init_all(start_addr,end_addr,init_value);
+	printf("puf init complete\n");
+	phase_end("init");
+
+	/* Decay & Manually Refresh */
+	puf_decay(decay_time, func_loc, dcy_func, nfreq);
+
+	/* Enable Refresh */
+	timing_init();
+	phase_end("refresh");
 }
 
 /**
@@ -258,19 +315,8 @@ void puf_read_itvl(unsigned long start_addr, unsigned long end_addr, unsigned in
 		{
 			for(unsigned int j=0; j<1024; j++)
 			{
-				unsigned long bank, row, col;
-			    if(add_mode==0)
-				{
-					bank=(0x1c000000&addr)>>26;				//calculate the number of bank
-				    row=(0x03fff000&addr)>>12;				//calculate the number of row
-				    col=(0x00000ffc&addr)>>2;				//calculate the number of column
-				}
-				else
-				{
-					row=(0x1fff8000&addr)>>15;				//28:15
-				    bank=(0x00007000&addr)>>12;				//14:12
-				    col=(0x00000ffc&addr)>>2;				//calculate the number of column
-				}
+				uint32_t bank, row, col=(0x00000ffc&addr)>>2;
+				puf_decode_row(addr, add_mode, &bank, &row);
 
 				/* calculate the number of bit-flip in one cell */
 				puf_read_val=mmio_read32(addr);
@@ -285,281 +331,1173 @@ void puf_read_itvl(unsigned long start_addr, unsigned long end_addr, unsigned in
 
 		}
 	}
-	while(1)
-	{
-		printf("puf_cell=%d\n",puf_cell);
-		delay_ms(100);
-
-	}
+	printf("puf_cell=%d\n",puf_cell);
+	phase_end("transmit");
+	puf_close();
 }
 
 /**
- * Description: Read the value of puf of one cell to 
- * the specified address segment
- * 
- * Input: puf_addr
+ * Description: Send every word of the specified address segment in
+ * the PUF windows as it is
+ *
+ * Input: start_addr, end_addr, init_value (unused)
  *
+ * Return: The number of cells
 **/
-uint32_t puf_read_all(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+uint32_t puf_encode_all(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
 {
-	putchar(0x16); // SYN
-	putchar(0x16); // SYN
-	putchar(0x16); // SYN
-    printf("&|");
-	uint32_t puf_read_val=0, puf_cell=0;
-	unsigned long addr, bank, row, col;
-    if(add_mode==0)
-    {
-        bank=(0x1c000000&start_addr)>>26;				//calculate the number of bank
-        row=(0x03fff000&start_addr)>>12;				//calculate the number of row
-        col=(0x00000ffc&start_addr)>>2;					//calculate the number of column
-    }
-    else
-    {
-        row=(0x1fff8000&start_addr)>>15;				//28:15
-        bank=(0x00007000&start_addr)>>12;				//14:12
-        col=(0x00000ffc&start_addr)>>2;					//calculate the number of column
-    }
-    printf("%d%04X%03X,", bank, row, col);
+	uint32_t cells=0;
+	unsigned long addr;
+	chunk_begin();
 	for (addr=start_addr;addr<end_addr;addr+=4)
 	{
-		if(addr >= end_addr)
-	    	break;
-		else if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
+		if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
 		{
-			++puf_cell;
-			puf_read_val=mmio_read32(addr);
-			printfBinary("%c%c%c%c", (unsigned char)(puf_read_val>>24),
-							   (unsigned char)(puf_read_val>>16),
-							   (unsigned char)(puf_read_val>>8),
-							   (unsigned char)puf_read_val);
+			++cells;
+			chunk_put_word(addr, mmio_read32(addr));
 		}
 	}
-    printf("|&%d|$\n",puf_cell);
-    delay_ms(100);
-	return puf_cell;
+	chunk_end();
+	return cells;
 }
 
 /**
  * Description: Read the value of puf of one cell to 
- * the specified address segment
+ * the specified address segment, sent in CRC-checked chunks (see chunk.c)
  * 
  * Input: puf_addr
  *
 **/
-void puf_read_ext(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+uint32_t puf_read_all(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
 {
-    printf("&|");
-	unsigned int puf_read_val=0;
+	puf_header(start_addr, add_mode);
+    printf(",");
+	uint32_t puf_cell=pipe_encode(puf_encode_all, start_addr, end_addr, 0);
+	chunk_stats();
+	/* Refresh is back on, so the decayed image can still be sent again */
+	puf_footer(puf_cell, start_addr, end_addr, 0, 0);
+	puf_close();
+	return puf_cell;
+}
+
+/**
+ * Description: Encode the cells differing from init_value as records of
+ *   cell delta (LEB128 varint) | cell ^ init_value (4, big endian)
+ * with cells numbered like the words of puf_read_all. A record never spans two chunks, the delta of the first
+ * record in a chunk is its cell number + 1, later ones count from the previous record, so every chunk can be
+ * decoded on its own. A 0 byte in place of a delta fills up the chunk. The stream is padded to whole words.
+ *
+ * Input: start_addr, end_addr, init_value
+ *
+ * Return: The number of cells differing from init_value
+**/
+uint32_t puf_encode_sparse(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	uint32_t cell=0, base=0, changed=0;
 	unsigned long addr;
-	unsigned long puf_cell=0;
-	short got_val=0;
+	chunk_begin();
 	for (addr=start_addr;addr<end_addr;addr+=4)
 	{
-		unsigned long bank, row, col;
-	    if(add_mode==0)
-		{
-			bank=(0x1c000000&addr)>>26;				//calculate the number of bank
-		    row=(0x03fff000&addr)>>12;				//calculate the number of row
-		    col=(0x00000ffc&addr)>>2;					//calculate the number of column
-		}
-		else
-		{
-			row=(0x1fff8000&addr)>>15;				//28:15
-		    bank=(0x00007000&addr)>>12;				//14:12
-		    col=(0x00000ffc&addr)>>2;					//calculate the number of column
-		}
-		/* calculate the number of bit-flip in one cell */
-		puf_read_val=mmio_read32(addr);
-		unsigned int sum_flip=cal(puf_read_val);
-		if(sum_flip!=0)
+		if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
 		{
-			puf_cell++;
-            if (got_val == 1)
-            {
-                printf(",");
-            }
-			printf("%d%04X%03X=%04d",bank ,row ,col ,sum_flip);
-            got_val=1;
+			uint32_t diff=mmio_read32(addr)^init_value;
+			if (diff!=0)
+			{
+				chunk_reserve(9, addr);
+				if (chunk_len==0)
+					base=0;
+				uint32_t delta=cell+1-base;
+				while (delta>=0x80)
+				{
+					chunk_put_byte((delta & 0x7F) | 0x80);
+					delta>>=7;
+				}
+				chunk_put_byte(delta);
+				chunk_put_byte(diff >> 24);
+				chunk_put_byte(diff >> 16);
+				chunk_put_byte(diff >> 8);
+				chunk_put_byte(diff);
+				base=cell+1;
+				++changed;
+			}
+			++cell;
 		}
 	}
-	printf("|&%d\n",puf_cell);
-	delay_ms(100);
+	while (chunk_len%4!=0)
+		chunk_put_byte(0);
+	chunk_end();
+	return changed;
 }
 
 /**
- * Description: Read the value of puf of one cell to 
- * the specified address segment
- * 
- * Input: puf_addr
+ * Description: Read the cells of the specified address segment which
+ * differ from init_value (see puf_encode_sparse). The header carries the
+ * init value and the number of cells, so the host can expand it to the
+ * output of puf_read_all.
+ *
+ * Input: start_addr, end_addr, add_mode, init_value
  *
 **/
-void puf_read_brc(unsigned long start_addr, unsigned long end_addr)
+uint32_t puf_read_sparse(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode, unsigned int init_value)
 {
-	unsigned int puf_read_val=0;
+	uint32_t puf_cell=0;
 	unsigned long addr;
-	unsigned long sum_flip=0;
-	unsigned long puf_cell=0;
-
 	for (addr=start_addr;addr<end_addr;addr+=4)
 	{
-		/* calculate the number of bit-flip in one cell */
-		puf_read_val=mmio_read32(addr);
-		unsigned int bit_flip=cal(puf_read_val);
-		if(bit_flip!=0)
-		{
-			puf_cell++;
-			sum_flip+=bit_flip;
-		}
-		
+		if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
+			++puf_cell;
 	}
-	while(1)
+	puf_header(start_addr, add_mode);
+    printf(":%08X:%08X,", init_value, puf_cell);
+	uint32_t changed=pipe_encode(puf_encode_sparse, start_addr, end_addr, init_value);
+	/* In words of payload like the dense readout, for the host to know the size if the end chunk is lost */
+	puf_footer(chunk_total/4, start_addr, end_addr, init_value, puf_encode_sparse);
+    printf("%d of %d cells changed\n", changed, puf_cell);
+	puf_close();
+	return changed;
+}
+
+#define RLE_MAX_LITERAL (PUF_WORK_RLE_SIZE/4-1)
+
+/* State of puf_encode_rle, the literal run in SDRAM next to the chunk buffer */
+static uint32_t* const rle_literal=(uint32_t*)PUF_WORK_RLE;
+static uint32_t rle_literal_len, rle_cell, rle_start, rle_end;
+
+/**
+ * Description: Make room for len bytes of a token, a new chunk starts
+ * with the number of its first cell
+ *
+ * Input: len
+**/
+void rle_reserve(uint32_t len)
+{
+	chunk_reserve(len, chunk_word_addr(rle_start, rle_end, rle_cell));
+	if (chunk_len==0)
 	{
-		printf("puf_cell=%d\n",puf_cell);
-		delay_ms(100);
+		chunk_put_byte(rle_cell >> 24);
+		chunk_put_byte(rle_cell >> 16);
+		chunk_put_byte(rle_cell >> 8);
+		chunk_put_byte(rle_cell);
+	}
+}
 
+/**
+ * Description: Send the pending literal words, split over as many
+ * chunks as needed
+**/
+void rle_flush_literal()
+{
+	uint32_t i=0;
+	while (i<rle_literal_len)
+	{
+		rle_reserve(5);
+		uint32_t n=(PUF_CHUNK_SIZE-chunk_len-1)/4;
+		if (n>rle_literal_len-i)
+			n=rle_literal_len-i;
+		chunk_put_byte(n);
+		for (uint32_t k=0; k<n; k++, i++)
+		{
+			uint32_t val=rle_literal[i];
+			chunk_put_byte(val >> 24);
+			chunk_put_byte(val >> 16);
+			chunk_put_byte(val >> 8);
+			chunk_put_byte(val);
+			rle_cell++;
+		}
 	}
-	printf("total bitflip = %d \n",sum_flip );
+	rle_literal_len=0;
 }
 
-/** 
- * Function: Test puf of contiguous address segment (return puf value)
+/**
+ * Description: Queue count equal words, two or more of them are sent
+ * as a run
  *
- * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+ * Input: val, count
 **/
-void puf_extract_all(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+void rle_put(uint32_t val, uint32_t count)
 {
-	/* PUF Init */
-	puf_init_all(start_addr,end_addr,puf_init_value);
-	printf("puf init complete\n");
-
-	/* Decay & Manually Refresh */ 
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	printf("disable Refresh\n");
-	SD_SA =
-	    (0 << SD_SA_RFSH_T_LSB)
-	    | SD_SA_PGEHLDE_SET
-	    | SD_SA_CLKSTOP_SET
-	    | SD_SA_POWSAVE_SET
-	    | 0x3214;
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	if(func_loc)
-		ManuallyRefresh(decay_time, dcy_func, nfreq);
-	else
-		ManuallyRefresh(decay_time, 0, 0);
-	printf("decay completed\n");
-
-	/* Enable Refresh */
-	timing_init();
-
-	/* PUF Read */
-	puf_read_all(start_addr, end_addr, add_mode);
+	if (count==1)
+	{
+		rle_literal[rle_literal_len++]=val;
+		if (rle_literal_len==RLE_MAX_LITERAL)
+			rle_flush_literal();
+		return;
+	}
+	rle_flush_literal();
+	rle_reserve(10);
+	chunk_put_byte(0x80);
+	uint32_t n=count;
+	while (n>=0x80)
+	{
+		chunk_put_byte((n & 0x7F) | 0x80);
+		n>>=7;
+	}
+	chunk_put_byte(n);
+	chunk_put_byte(val >> 24);
+	chunk_put_byte(val >> 16);
+	chunk_put_byte(val >> 8);
+	chunk_put_byte(val);
+	rle_cell+=count;
 }
 
-/** 
- * Function: Test puf of contiguous address segment (return bitflip of one cell)
+/**
+ * Description: Compress the cells of the specified address segment with
+ * a run length encoding of words, in tokens of
+ *   n (1 - 127) | n words            literal
+ *   0x80 | count (LEB128 varint) | word   run of count equal words
+ * A token never spans two chunks and every chunk starts with the number of its first cell (4, big endian), so every
+ * chunk can be decoded on its own. A 0 byte in place of a token fills up the chunk. The stream is padded to whole
+ * words. Only a literal of 127 words is buffered, so this runs in constant memory.
  *
- * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+ * Input: start_addr, end_addr, init_value (unused)
+ *
+ * Return: The number of cells
+**/
+uint32_t puf_encode_rle(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	uint32_t run_val=0, run_len=0, cells=0;
+	unsigned long addr;
+	rle_literal_len=0;
+	rle_cell=0;
+	rle_start=start_addr;
+	rle_end=end_addr;
+	chunk_begin();
+	for (addr=start_addr;addr<end_addr;addr+=4)
+	{
+		if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
+		{
+			uint32_t val=mmio_read32(addr);
+			if (run_len>0 && val!=run_val)
+			{
+				rle_put(run_val, run_len);
+				run_len=0;
+			}
+			run_val=val;
+			run_len++;
+			cells++;
+		}
+	}
+	if (run_len>0)
+		rle_put(run_val, run_len);
+	rle_flush_literal();
+	while (chunk_len%4!=0)
+		chunk_put_byte(0);
+	chunk_end();
+	return cells;
+}
+
+/**
+ * Description: Read the cells of the specified address segment run
+ * length encoded (see puf_encode_rle). The header carries the number of
+ * cells, so the host can expand it to the output of puf_read_all.
+ *
+ * Input: start_addr, end_addr, add_mode
+ *
+**/
+uint32_t puf_read_rle(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+{
+	uint32_t puf_cell=0;
+	unsigned long addr;
+	for (addr=start_addr;addr<end_addr;addr+=4)
+	{
+		if((addr>=0xC3000000&&addr<0xCf000000)||(addr>=0xD0000000&&addr<0xE0000000))
+			++puf_cell;
+	}
+	puf_header(start_addr, add_mode);
+    printf(";%08X,", puf_cell);
+	uint32_t tin=ST_CLO;
+	pipe_encode(puf_encode_rle, start_addr, end_addr, 0);
+	uint32_t encode_t=ST_CLO-tin;
+	/* In words of payload like the dense readout, for the host to know the size if the end chunk is lost */
+	puf_footer(chunk_total/4, start_addr, end_addr, 0, puf_encode_rle);
+    printf("%d bytes compressed to %d bytes in %d ms\n", puf_cell*4, chunk_total, encode_t/1000);
+	puf_close();
+	return puf_cell;
+}
+
+// Room for the encoded positions, about 3 bytes per position
+#define PUF_POS_BUF_SIZE PUF_WORK_POS_SIZE
+#define PUF_POS_TRIES 3
+// Microseconds to wait for every byte of the positions
+#define PUF_POS_TIMEOUT 1000000
+
+// In the SDRAM work area, L2 has no room for it
+static uint8_t* const puf_pos_buf=(uint8_t*)PUF_WORK_POS;
+static uint32_t puf_pos_len;
+
+/**
+ * Description: Receive the bit positions for puf_read_bits. The host
+ * answers the prompt with "<bytes> <CRC32>" and sends the positions
+ * right after the carriage return, as LEB128 varints of the distance to
+ * the previous position (the first one counted from 0). Positions count
+ * the bits of the output of puf_read_all after the header, most
+ * significant bit of every byte first.
+ *
+ * Return: 1 once the positions are complete and intact
+**/
+int puf_receive_positions()
+{
+	for (int tries=0; tries<PUF_POS_TRIES; tries++)
+	{
+		uint32_t len, crc, i;
+		printf("Positions|: ");
+		if (!chunk_read_request(&len, &crc))
+			continue;
+		for (i=0; i<len; i++)
+		{
+			int c=uart_getc(PUF_POS_TIMEOUT);
+			if (c<0)
+				break;
+			if (i<PUF_POS_BUF_SIZE)
+				puf_pos_buf[i]=c;
+		}
+		if (len>PUF_POS_BUF_SIZE)
+		{
+			printf("At most %d bytes of positions\n", PUF_POS_BUF_SIZE);
+			return 0;
+		}
+		if (i<len)
+			printf("Positions incomplete\n");
+		else if (crc32_update(0, puf_pos_buf, len)!=crc)
+			printf("Positions corrupted\n");
+		else
+		{
+			puf_pos_len=len;
+			printf("%d bytes of positions received\n", len);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Description: Send the bits at the received positions, packed most
+ * significant bit first and padded to whole words. A position outside
+ * the specified address segment reads as 0.
+ *
+ * Input: start_addr, end_addr, init_value (unused)
+ *
+ * Return: The number of bits
+**/
+uint32_t puf_encode_bits(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	uint32_t pos=0, delta=0, shift=0, bits=0, byte=0;
+	uint32_t cell=0xFFFFFFFF, val=0;
+	chunk_begin();
+	for (uint32_t i=0; i<puf_pos_len; i++)
+	{
+		delta|=(puf_pos_buf[i] & 0x7F) << shift;
+		shift+=7;
+		if (puf_pos_buf[i] & 0x80)
+			continue;
+		pos+=delta;
+		delta=0;
+		shift=0;
+		uint32_t addr=chunk_word_addr(start_addr, end_addr, pos/32);
+		if (pos/32!=cell)
+		{
+			cell=pos/32;
+			val=addr<end_addr ? mmio_read32(addr) : 0;
+		}
+		byte=(byte << 1) | ((val >> (31 - pos%32)) & 1);
+		if (++bits%8==0)
+		{
+			chunk_reserve(1, addr);
+			chunk_put_byte(byte);
+			byte=0;
+		}
+	}
+	if (bits%8!=0)
+	{
+		chunk_reserve(1, 0);
+		chunk_put_byte(byte << (8 - bits%8));
+	}
+	while (chunk_len%4!=0)
+		chunk_put_byte(0);
+	chunk_end();
+	return bits;
+}
+
+/**
+ * Description: Read only the bits at the received positions of the
+ * specified address segment (see puf_encode_bits), e.g. to generate a
+ * key from the stable cells
+ *
+ * Input: start_addr, end_addr, add_mode
+ *
+**/
+uint32_t puf_read_bits(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+{
+	uint32_t bits=0;
+	for (uint32_t i=0; i<puf_pos_len; i++)
+	{
+		if (!(puf_pos_buf[i] & 0x80))
+			++bits;
+	}
+	puf_header(start_addr, add_mode);
+    printf("!%08X,", bits);
+	pipe_encode(puf_encode_bits, start_addr, end_addr, 0);
+	puf_footer(chunk_total/4, start_addr, end_addr, 0, puf_encode_bits);
+	puf_close();
+	return bits;
+}
+
+#define PUF_MAX_STAGES 32
+#define PUF_SCHEDULE_SIZE PUF_WORK_SCHEDULE_SIZE
+#define PUF_SCHEDULE_TRIES 3
+// Rows are kept alive a row at a time, so stages consist of whole rows
+#define PUF_ROW_SIZE 0x1000
+// The system timer counts microseconds in 32 bits
+#define PUF_MAX_STAGE_TIME 4200
+
+struct puf_stage {
+	uint32_t start, end, due, elapsed;
+};
+
+static struct puf_stage puf_stages[PUF_MAX_STAGES];
+static uint32_t puf_stage_count;
+static char* const puf_schedule=(char*)PUF_WORK_SCHEDULE;
+
+/**
+ * Description: Read a line up to the carriage return, echoed like the
+ * kernel does with parameters
+ *
+ * Input: line, size
+ *
+ * Return: The length of the line, -1 if the host stays silent
+**/
+int puf_read_line(char* line, uint32_t size)
+{
+	uint32_t len=0;
+	for (;;)
+	{
+		int c=uart_getc(RESEND_TIMEOUT_S*1000000);
+		if (c<0)
+			return -1;
+		if (c=='\r')
+			break;
+		if (c>=' ' && c<='~' && len<size-1)
+		{
+			putchar(c);
+			line[len++]=c;
+		}
+	}
+	putchar('\n');
+	line[len]=0;
+	return len;
+}
+
+/**
+ * Description: Parse a number at *s and move past it
+ *
+ * Input: s, base (10 or 16)
+ *
+ * Return: The number, *s unchanged if there are no digits
+**/
+uint32_t puf_parse_number(const char** s, uint32_t base)
+{
+	uint32_t val=0;
+	for (;; (*s)++)
+	{
+		char c=**s;
+		if (c>='0' && c<='9')
+			val=val*base + (c-'0');
+		else if (base==16 && c>='A' && c<='F')
+			val=val*16 + (c-'A'+10);
+		else if (base==16 && c>='a' && c<='f')
+			val=val*16 + (c-'a'+10);
+		else
+			return val;
+	}
+}
+
+/**
+ * Description: Parse a schedule "start-end@seconds,..." (addresses in
+ * hex) into puf_stages, sorted by their read time. The stages have to
+ * consist of whole rows of the specified address segment, may not
+ * overlap and may not reach into 0xCF000000 - 0xD0000000.
+ *
+ * Input: schedule, start_addr, end_addr
+ *
+ * Return: The number of stages, 0 for an invalid schedule
+**/
+uint32_t puf_parse_schedule(const char* s, unsigned long start_addr, unsigned long end_addr)
+{
+	uint32_t n=0;
+	while (*s)
+	{
+		struct puf_stage stage;
+		const char* begin=s;
+		stage.start=puf_parse_number(&s, 16);
+		if (s==begin || *s++!='-')
+			return 0;
+		begin=s;
+		stage.end=puf_parse_number(&s, 16);
+		if (s==begin || *s++!='@')
+			return 0;
+		begin=s;
+		stage.due=puf_parse_number(&s, 10);
+		if (s==begin || (*s && *s++!=','))
+			return 0;
+		stage.elapsed=0;
+		if (n==PUF_MAX_STAGES || stage.start>=stage.end || stage.start<start_addr || stage.end>end_addr ||
+			(stage.start % PUF_ROW_SIZE) || (stage.end % PUF_ROW_SIZE) || stage.due>PUF_MAX_STAGE_TIME ||
+			(stage.start<0xD0000000 && stage.end>0xCF000000))
+			return 0;
+		for (uint32_t i=0; i<n; i++)
+		{
+			if (stage.start<puf_stages[i].end && puf_stages[i].start<stage.end)
+				return 0;
+		}
+		/* Insert sorted by the read time */
+		uint32_t i=n++;
+		for (; i>0 && puf_stages[i-1].due>stage.due; i--)
+			puf_stages[i]=puf_stages[i-1];
+		puf_stages[i]=stage;
+	}
+	return n;
+}
+
+/**
+ * Description: Receive the schedule of the staggered readout
+ *
+ * Input: start_addr, end_addr
+ *
+ * Return: 1 once a valid schedule is received
+**/
+int puf_receive_schedule(unsigned long start_addr, unsigned long end_addr)
+{
+	for (int tries=0; tries<PUF_SCHEDULE_TRIES; tries++)
+	{
+		printf("Schedule|: ");
+		if (puf_read_line(puf_schedule, PUF_SCHEDULE_SIZE)<0)
+			continue;
+		puf_stage_count=puf_parse_schedule(puf_schedule, start_addr, end_addr);
+		if (puf_stage_count>0)
+			return 1;
+		printf("Invalid schedule, expected start-end@seconds,... with whole rows of 0x%08X - 0x%08X\n",
+			start_addr, end_addr);
+	}
+	return 0;
+}
+
+/**
+ * Description: Read one word of every row of the first count stages.
+ * The first read of a stage freezes its decay, afterwards it keeps the
+ * stage from decaying further.
+ *
+ * Input: count
+**/
+void puf_keep_stages(uint32_t count)
+{
+	for (uint32_t i=0; i<count; i++)
+	{
+		for (uint32_t addr=puf_stages[i].start; addr<puf_stages[i].end; addr+=PUF_ROW_SIZE)
+			mmio_read32(addr);
+	}
+}
+
+/**
+ * Description: Wait until due microseconds after the start of the decay
+ * with refresh disabled, keeping the code rows and the stages read so
+ * far alive (see sched.c)
+ *
+ * Input: due, count, dcy_func
+**/
+void puf_wait_stage(uint32_t due, uint32_t count, int dcy_func)
+{
+	sched_wait(due, dcy_func, count);
+}
+
+/**
+ * Description: Send the stages in the order they were read, every stage
+ * in chunks tagged with its elapsed time in ms
+ *
+ * Input: start_addr, end_addr, init_value (unused)
+ *
+ * Return: The number of cells
+**/
+uint32_t puf_encode_stages(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	uint32_t cells=0;
+	chunk_begin();
+	for (uint32_t i=0; i<puf_stage_count; i++)
+	{
+		chunk_set_tag(puf_stages[i].elapsed);
+		for (uint32_t addr=puf_stages[i].start; addr<puf_stages[i].end; addr+=4)
+		{
+			chunk_put_word(addr, mmio_read32(addr));
+			++cells;
+		}
+	}
+	chunk_end();
+	return cells;
+}
+
+/**
+ * Description: Send the stages of a staggered readout, once refresh is
+ * enabled again (see puf_encode_stages)
+ *
+ * Input: start_addr, end_addr, add_mode
+ *
+**/
+uint32_t puf_read_stages(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+{
+	puf_header(start_addr, add_mode);
+    printf("~%d,", puf_stage_count);
+	uint32_t puf_cell=pipe_encode(puf_encode_stages, start_addr, end_addr, 0);
+	puf_footer(puf_cell, start_addr, end_addr, 0, puf_encode_stages);
+	for (uint32_t i=0; i<puf_stage_count; i++)
+		printf("0x%08X - 0x%08X read after %d ms\n", puf_stages[i].start, puf_stages[i].end, puf_stages[i].elapsed);
+	puf_close();
+	return puf_cell;
+}
+
+/*
+ * Adaptive decay: probe rows outside of the range decay along with it and one of them is read at a time, evenly
+ * spread over the decay time. Reading a row restores it, so every probe row can only be sampled once. The decay stops
+ * as soon as a probe row has flipped at least the target rate, or after the decay time if none does.
+ */
+
+#define PUF_MAX_PROBES 64
+#define PUF_PROBE_SIZE 64
+#define PUF_PROBE_TRIES 3
+
+static uint32_t puf_probe_start, puf_probe_count, puf_probe_target;
+static char puf_probe_line[PUF_PROBE_SIZE];
+
+/**
+ * Description: Parse the probe rows and the target "start-end@ppm" (addresses in hex). The probe rows have to be
+ * whole rows of the PUF windows outside of the range.
+ *
+ * Input: s, start_addr, end_addr
+ *
+ * Return: 1 if valid
+**/
+int puf_parse_probes(const char* s, unsigned long start_addr, unsigned long end_addr)
+{
+	const char* begin=s;
+	uint32_t start=puf_parse_number(&s, 16);
+	if (s==begin || *s++!='-')
+		return 0;
+	begin=s;
+	uint32_t end=puf_parse_number(&s, 16);
+	if (s==begin || *s++!='@')
+		return 0;
+	begin=s;
+	uint32_t target=puf_parse_number(&s, 10);
+	if (s==begin || *s || target==0 || target>1000000)
+		return 0;
+	if (start>=end || (start % PUF_ROW_SIZE) || (end % PUF_ROW_SIZE) || (end-start)/PUF_ROW_SIZE>PUF_MAX_PROBES ||
+		start<0xC3000000 || end>0xE0000000 || (start<0xD0000000 && end>0xCF000000) ||
+		(start<=end_addr && start_addr<end))
+		return 0;
+	for (int i=0; i<PUF_MR_ROWS; i++)
+	{
+		if (MRList[i]>=start && MRList[i]<end)
+			return 0;
+	}
+	puf_probe_start=start;
+	puf_probe_count=(end-start)/PUF_ROW_SIZE;
+	puf_probe_target=target;
+	return 1;
+}
+
+/**
+ * Description: Receive the probe rows and the target of the adaptive decay
+ *
+ * Input: start_addr, end_addr
+ *
+ * Return: 1 once valid ones are received
+**/
+int puf_receive_probes(unsigned long start_addr, unsigned long end_addr)
+{
+	for (int tries=0; tries<PUF_PROBE_TRIES; tries++)
+	{
+		printf("Probes|: ");
+		if (puf_read_line(puf_probe_line, PUF_PROBE_SIZE)<0)
+			continue;
+		if (puf_parse_probes(puf_probe_line, start_addr, end_addr))
+			return 1;
+		printf("Invalid probes, expected start-end@ppm with up to %d whole rows outside of 0x%08X - 0x%08X\n",
+			PUF_MAX_PROBES, start_addr, end_addr);
+	}
+	return 0;
+}
+
+/**
+ * Description: Read a probe row, which restores it
+ *
+ * Input: addr, init_value
+ *
+ * Return: Flipped bits per million
+**/
+uint32_t puf_sample_probe(unsigned long addr, unsigned int init_value)
+{
+	uint32_t flips=0;
+	for (unsigned long end=addr+PUF_ROW_SIZE; addr<end; addr+=4)
+		flips+=cal(mmio_read32(addr)^init_value);
+	// 10^6 / (PUF_ROW_SIZE * 8) without overflowing
+	return flips*15625/512;
+}
+
+/**
+ * Description: Decay with refresh disabled until a probe row reaches the target flip rate, keeping the code rows
+ * alive (see sched.c)
+ *
+ * Input: decay_time (the longest decay), init_value, dcy_func
+ *
+ * Return: The elapsed time in ms
+**/
+uint32_t puf_adaptive_decay(int decay_time, unsigned int init_value, int dcy_func)
+{
+	uint32_t step=(uint32_t)decay_time*1000000/puf_probe_count;
+	uint32_t t0=ST_CLO, rate=0, i=0;
+	sched_start(t0, 0);
+	while (i<puf_probe_count)
+	{
+		sched_wait((i+1)*step, dcy_func, 0);
+		rate=puf_sample_probe(puf_probe_start+i*PUF_ROW_SIZE, init_value);
+		i++;
+		if (rate>=puf_probe_target)
+			break;
+	}
+	uint32_t elapsed=(ST_CLO-t0)/1000;
+	sched_stop();
+	if (rate>=puf_probe_target)
+		printf("Target of %d ppm reached by probe row %d of %d with %d ppm, decay stopped after %d ms\n",
+			puf_probe_target, i, puf_probe_count, rate, elapsed);
+	else
+		printf("Target of %d ppm not reached, last probe row at %d ppm, decay stopped after %d ms\n",
+			puf_probe_target, rate, elapsed);
+	return elapsed;
+}
+
+/*
+ * Flip statistics: instead of the cells, a table of flipped bits is sent, counted by bank, by row and by column as
+ * decoded per add_mode, along with how many cells have how many bits flipped. All numbers are words (big endian):
+ *   cells | first row | row shift | cells with 0 - 32 bits flipped (33) | flipped bits per bank (8) |
+ *   per row (256, rows first row + (i << row shift) onwards) | per column (1024)
+ * The rows of the range are spread over the 256 row counts, all of them if the range spans several banks in BRC.
+ */
+
+#define PUF_STAT_BANKS 8
+#define PUF_STAT_ROWS 256
+#define PUF_STAT_COLS 1024
+#define PUF_STAT_HEADER 3
+#define PUF_STAT_WORDS (PUF_STAT_HEADER + 33 + PUF_STAT_BANKS + PUF_STAT_ROWS + PUF_STAT_COLS)
+
+// In the SDRAM work area, L2 has no room for its 5296 bytes. The counts per cell and per bank are kept on the
+// stack while counting, only rows and columns are added up in SDRAM.
+static uint32_t* const puf_stats=(uint32_t*)PUF_WORK_STATS;
+_Static_assert(PUF_STAT_WORDS*4 <= PUF_WORK_STATS_SIZE, "puf_stats doesn't fit into its work area");
+
+/**
+ * Description: Count the flipped bits of the range into puf_stats, the rows of MRList left out
+ *
+ * Input: start_addr, end_addr, init_value, add_mode
+ *
+ * Return: The number of flipped bits
+**/
+uint32_t puf_count_stats(unsigned long start_addr, unsigned long end_addr, unsigned int init_value, unsigned int add_mode)
+{
+	uint32_t cells[33], banks[PUF_STAT_BANKS];
+	uint32_t* rows=&puf_stats[PUF_STAT_HEADER+33+PUF_STAT_BANKS];
+	uint32_t* cols=rows+PUF_STAT_ROWS;
+	for (uint32_t i=0; i<33; i++)
+		cells[i]=0;
+	for (uint32_t i=0; i<PUF_STAT_BANKS; i++)
+		banks[i]=0;
+	for (uint32_t i=0; i<PUF_STAT_ROWS+PUF_STAT_COLS; i++)
+		rows[i]=0;
+
+	uint32_t first_bank, first_row, last_bank, last_row, shift=0;
+	puf_decode_row(start_addr, add_mode, &first_bank, &first_row);
+	puf_decode_row(end_addr-4, add_mode, &last_bank, &last_row);
+	if (add_mode==0 && first_bank!=last_bank)
+	{
+		first_row=0;
+		last_row=0x3fff;
+	}
+	while (((last_row-first_row) >> shift) >= PUF_STAT_ROWS)
+		shift++;
+	puf_stats[1]=first_row;
+	puf_stats[2]=shift;
+
+	uint32_t total=0, flips=0;
+	struct puf_segment seg[PUF_MAX_SEGMENTS];
+	int n=puf_segments(start_addr, end_addr-4, seg);
+	for (int i=0; i<n; i++)
+	{
+		for (unsigned long addr=seg[i].start; addr<seg[i].end;)
+		{
+			/* Bank and row stay the same within a row */
+			uint32_t bank, row;
+			puf_decode_row(addr, add_mode, &bank, &row);
+			uint32_t row_flips=0;
+			unsigned long end=(addr | (PUF_ROW_SIZE-1)) + 1;
+			if (end>seg[i].end)
+				end=seg[i].end;
+			for (; addr<end; addr+=4)
+			{
+				uint32_t k=cal(mmio_read32(addr)^init_value);
+				cells[k]++;
+				cols[(0x00000ffc&addr)>>2]+=k;
+				row_flips+=k;
+				total++;
+			}
+			banks[bank]+=row_flips;
+			if (row>=first_row && ((row-first_row) >> shift)<PUF_STAT_ROWS)
+				rows[(row-first_row) >> shift]+=row_flips;
+			flips+=row_flips;
+		}
+	}
+	puf_stats[0]=total;
+	for (uint32_t i=0; i<33; i++)
+		puf_stats[PUF_STAT_HEADER+i]=cells[i];
+	for (uint32_t i=0; i<PUF_STAT_BANKS; i++)
+		puf_stats[PUF_STAT_HEADER+33+i]=banks[i];
+	return flips;
+}
+
+/**
+ * Description: Send puf_stats
+ *
+ * Input: start_addr, end_addr, init_value (unused)
+ *
+ * Return: The number of words sent
+**/
+uint32_t puf_encode_stats(unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	chunk_begin();
+	for (uint32_t i=0; i<PUF_STAT_WORDS; i++)
+		chunk_put_word(start_addr, puf_stats[i]);
+	chunk_end();
+	return PUF_STAT_WORDS;
+}
+
+/**
+ * Description: Count and send the flip statistics of the range (see puf_count_stats), framed like puf_read_all
+ * with the header "<bank><row><col>#<init value>,"
+ *
+ * Input: start_addr, end_addr, init_value, add_mode
+ *
+ * Return: The number of flipped bits
+**/
+uint32_t puf_read_stats(unsigned long start_addr, unsigned long end_addr, unsigned int init_value, unsigned int add_mode)
+{
+	uint32_t tin=ST_CLO;
+	uint32_t flips=puf_count_stats(start_addr, end_addr, init_value, add_mode);
+	phase_end("read");
+	printf("%d bits flipped in %d cells, counted in %d ms\n", flips, puf_stats[0], (ST_CLO-tin)/1000);
+
+	puf_header(start_addr, add_mode);
+    printf("#%08X,", init_value);
+	uint32_t words=pipe_encode(puf_encode_stats, start_addr, end_addr, init_value);
+	puf_footer(words, start_addr, end_addr, init_value, puf_encode_stats);
+	puf_close();
+	return flips;
+}
+
+/**
+ * Description: Read the value of puf of one cell to 
+ * the specified address segment
+ * 
+ * Input: puf_addr
+ *
+**/
+void puf_read_ext(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode)
+{
+    printf("&|");
+	unsigned int puf_read_val=0;
+	unsigned long addr;
+	unsigned long puf_cell=0;
+	short got_val=0;
+	for (addr=start_addr;addr<end_addr;addr+=4)
+	{
+		uint32_t bank, row, col=(0x00000ffc&addr)>>2;
+		puf_decode_row(addr, add_mode, &bank, &row);
+		/* calculate the number of bit-flip in one cell */
+		puf_read_val=mmio_read32(addr);
+		unsigned int sum_flip=cal(puf_read_val);
+		if(sum_flip!=0)
+		{
+			puf_cell++;
+            if (got_val == 1)
+            {
+                printf(",");
+            }
+			printf("%d%04X%03X=%04d",bank ,row ,col ,sum_flip);
+            got_val=1;
+		}
+	}
+	printf("|&%d\n",puf_cell);
+	phase_end("transmit");
+	puf_close();
+}
+
+/**
+ * Description: Read the value of puf of one cell to 
+ * the specified address segment
+ * 
+ * Input: puf_addr
+ *
+**/
+void puf_read_brc(unsigned long start_addr, unsigned long end_addr)
+{
+	unsigned int puf_read_val=0;
+	unsigned long addr;
+	unsigned long sum_flip=0;
+	unsigned long puf_cell=0;
+
+	for (addr=start_addr;addr<end_addr;addr+=4)
+	{
+		/* calculate the number of bit-flip in one cell */
+		puf_read_val=mmio_read32(addr);
+		unsigned int bit_flip=cal(puf_read_val);
+		if(bit_flip!=0)
+		{
+			puf_cell++;
+			sum_flip+=bit_flip;
+		}
+		
+	}
+	phase_end("read");
+	printf("puf_cell=%d\n",puf_cell);
+	printf("total bitflip = %d \n",sum_flip );
+	phase_end("transmit");
+	puf_close();
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return puf value)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_all(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_all(start_addr, end_addr, add_mode);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return bitflip of one cell)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
 **/
 void puf_extracted(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
 {
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_ext(start_addr, end_addr, add_mode);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return total bitflip)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_brc(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_brc(start_addr, end_addr);
+}
+
+/** 
+ * Function: Test puf at interval
+ *
+ * Input: puf_start_address, puf_end_address, puf_extract_interval, puf_init_value, decay_time
+ *
+ * P.S. Test one row for each interval
+**/
+void puf_extract_itvl(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value,int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read (on GPU)*/
+	puf_read_itvl(start_addr, end_addr, add_mode);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return changed cells only)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_sparse(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_sparse(start_addr, end_addr, add_mode, puf_init_value);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return compressed puf value)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_rle(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_rle(start_addr, end_addr, add_mode);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment (return the bits at the positions the host sends first)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_bits(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	/* Positions, before anything decays */
+	if (!puf_receive_positions())
+		panic("No positions received");
+	phase_end("upload");
+
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_bits(start_addr, end_addr, add_mode);
+}
+
+/** 
+ * Function: Test puf of contiguous address segment, reading every sub-range of the schedule the host sends first
+ * at its own decay time within one decay
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time (unused, see the schedule)
+**/
+void puf_extract_stages(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	/* Schedule, before anything decays */
+	if (!puf_receive_schedule(start_addr, end_addr))
+		panic("No schedule received");
+	phase_end("upload");
+
 	/* PUF Init */
 	puf_init_all(start_addr,end_addr,puf_init_value);
 	printf("puf init complete\n");
+	phase_end("init");
 
 	/* Decay & Manually Refresh */ 
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	printf("disable Refresh\n");
-	SD_SA =
-	    (0 << SD_SA_RFSH_T_LSB)
-	    | SD_SA_PGEHLDE_SET
-	    | SD_SA_CLKSTOP_SET
-	    | SD_SA_POWSAVE_SET
-	    | 0x3214;
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	if(func_loc)
-		ManuallyRefresh(decay_time, dcy_func, nfreq);
-	else
-		ManuallyRefresh(decay_time, 0, 0);
+	puf_refresh_off();
+	uint32_t t0=ST_CLO;
+	sched_start(t0, 0);
+	for (uint32_t i=0; i<puf_stage_count; i++)
+	{
+		puf_wait_stage(puf_stages[i].due*1000000, i, func_loc ? dcy_func : 0);
+		puf_stages[i].elapsed=(ST_CLO-t0)/1000;
+		puf_keep_stages(i+1);
+	}
+	sched_stop();
 	printf("decay completed\n");
+	phase_end("decay");
 
 	/* Enable Refresh */
 	timing_init();
+	phase_end("refresh");
 
 	/* PUF Read */
-	puf_read_ext(start_addr, end_addr, add_mode);
-
+	puf_read_stages(start_addr, end_addr, add_mode);
 }
 
 /** 
- * Function: Test puf of contiguous address segment (return total bitflip)
+ * Function: Test puf of contiguous address segment (return puf value), decaying in self refresh with only the
+ * banks and segments of the range masked (see pasr_decay)
  *
  * Input: puf_start_address, puf_end address, puf_init_value, decay_time
 **/
-void puf_extract_brc(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+void puf_extract_pasr(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
 {
+	phase_start();
+	struct pasr_masks m;
+	pasr_choose_masks(start_addr, end_addr, add_mode, &m);
+	printf("PASR bank mask 0x%02X, segment mask 0x%02X, %d of %d rows keep their refresh\n", m.bank, m.segment,
+	       m.kept, m.rows);
 
 	/* PUF Init */
 	puf_init_all(start_addr,end_addr,puf_init_value);
 	printf("puf init complete\n");
+	phase_end("init");
 
-	/* Decay & Manually Refresh */ 
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	printf("disable Refresh\n");
-	SD_SA =
-	    (0 << SD_SA_RFSH_T_LSB)
-	    | SD_SA_PGEHLDE_SET
-	    | SD_SA_CLKSTOP_SET
-	    | SD_SA_POWSAVE_SET
-	    | 0x3214;
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	if(func_loc)
-		ManuallyRefresh(decay_time, dcy_func, nfreq);
-	else
-		ManuallyRefresh(decay_time, 0, 0);
-	printf("decay completed\n");
+	/* Decay in self refresh, the SDRAM refreshes the code rows itself */
+	uint32_t on_stack=0;
+	if (!PASR_IN_L2(&_end - 1) || !PASR_IN_L2(&on_stack))
+		panic("The image (up to 0x%08X) and the stack (0x%08X) must be in L2 for self refresh", (uint32_t)&_end,
+		      (uint32_t)&on_stack);
+	printf("enter self refresh\n");
+	pasr_decay(&m, decay_time, func_loc ? dcy_func : 0, nfreq);
+	phase_end("decay");
 
 	/* Enable Refresh */
 	timing_init();
+	pasr_clear();
+	printf("decay completed\n");
+	phase_end("refresh");
 
 	/* PUF Read */
-	puf_read_brc(start_addr, end_addr);
-
+	puf_read_all(start_addr, end_addr, add_mode);
 }
 
 /** 
- * Function: Test puf at interval
- *
- * Input: puf_start_address, puf_end_address, puf_extract_interval, puf_init_value, decay_time
+ * Function: Test puf of contiguous address segment (return puf value), decaying until the probe rows the host
+ * sends first reach the target flip rate (see puf_adaptive_decay)
  *
- * P.S. Test one row for each interval
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time (the longest decay)
 **/
-void puf_extract_itvl(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value,int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+void puf_extract_adaptive(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
 {
+	phase_start();
+	/* Probe rows, before anything decays */
+	if (!puf_receive_probes(start_addr, end_addr))
+		panic("No probe rows received");
+	phase_end("upload");
+
 	/* PUF Init */
 	puf_init_all(start_addr,end_addr,puf_init_value);
+	puf_init_all(puf_probe_start, puf_probe_start+puf_probe_count*PUF_ROW_SIZE-4, puf_init_value);
 	printf("puf init complete\n");
+	phase_end("init");
 
-	/* Decay & Manually Refresh */
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	printf("disable Refresh\n");
-	SD_SA =
-	    (0 << SD_SA_RFSH_T_LSB)
-	    | SD_SA_PGEHLDE_SET
-	    | SD_SA_CLKSTOP_SET
-	    | SD_SA_POWSAVE_SET
-	    | 0x3214;
-	// printf("SD_SA:value=0x%08X--address=0x%08X\n",SD_SA,&(SD_SA));
-	if(func_loc)
-		ManuallyRefresh(decay_time, dcy_func, nfreq);
-	else
-		ManuallyRefresh(decay_time, 0, 0);
+	/* Decay & Manually Refresh */ 
+	puf_refresh_off();
+	puf_adaptive_decay(decay_time, puf_init_value, func_loc ? dcy_func : 0);
 	printf("decay completed\n");
+	phase_end("decay");
 
 	/* Enable Refresh */
 	timing_init();
+	phase_end("refresh");
 
-	/* PUF Read (on GPU)*/
-	puf_read_itvl(start_addr, end_addr, add_mode);
+	/* PUF Read */
+	puf_read_all(start_addr, end_addr, add_mode);
 }
 
+/** 
+ * Function: Test puf of contiguous address segment (return flip statistics instead of the cells, see
+ * puf_count_stats)
+ *
+ * Input: puf_start_address, puf_end address, puf_init_value, decay_time
+**/
+void puf_extract_stats(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value, int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	phase_start();
+	puf_init_decay(start_addr, end_addr, puf_init_value, decay_time, func_loc, dcy_func, nfreq);
+
+	/* PUF Read */
+	puf_read_stats(start_addr, end_addr, puf_init_value, add_mode);
+}
@@ -21,4 +21,25 @@
 #define LED_GPFBIT 21
 #define LED_GPCLR 11
 #define LED_GPIO_BIT 15
-#define LED_GPSET 8
\ No newline at end of file
+#define LED_GPSET 8
+/*
+ * Work area of the firmware in SDRAM, for buffers which don't fit into the 128 KB of L2 the VPU runs from. It lies
+ * in the rows from 0xCF400000, outside of the PUF windows (see window.c) and in the bank and segment of the code rows
+ * at 0xCF000000, so PASR never masks it. Accessed through the uncached alias like the PUF.
+ */
+#define PUF_WORK_BASE             0xCF400000
+// Encoded positions of puf_read_bits, kept alive during the decay by Refresh()
+#define PUF_WORK_POS              PUF_WORK_BASE
+#define PUF_WORK_POS_SIZE         0x4000
+// Flip statistics of puf_read_stats, only used once refresh is back on
+#define PUF_WORK_STATS            (PUF_WORK_POS + PUF_WORK_POS_SIZE)
+#define PUF_WORK_STATS_SIZE       0x2000
+// Payload of the chunk being encoded (see chunk.c)
+#define PUF_WORK_CHUNK            (PUF_WORK_STATS + PUF_WORK_STATS_SIZE)
+#define PUF_WORK_CHUNK_SIZE       0x400
+// Schedule line of puf_extract_stages, parsed before the decay
+#define PUF_WORK_SCHEDULE         (PUF_WORK_CHUNK + PUF_WORK_CHUNK_SIZE)
+#define PUF_WORK_SCHEDULE_SIZE    0x400
+// Literal run of the RLE encoder
+#define PUF_WORK_RLE              (PUF_WORK_SCHEDULE + PUF_WORK_SCHEDULE_SIZE)
+#define PUF_WORK_RLE_SIZE         0x200
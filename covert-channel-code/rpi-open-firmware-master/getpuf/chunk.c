@@ -0,0 +1,309 @@
+#include <lib/runtime.h>
+#include "hardware.h"
+#include "PufAddress.h"
+
+/**
+ * Framed transport of the PUF readout.
+ *
+ * Every chunk is sent as
+ *   magic "PUF\x16" | seq (4) | address (4) | length (2) | payload (length) | CRC32 (4)
+ * with all numbers big endian and the CRC32 (IEEE) taken over everything after the magic. All chunks but the last
+ * one carry PUF_CHUNK_SIZE bytes, so the host can place a chunk by its sequence number alone. A chunk without
+ * payload ends the readout, in place of the address it carries the total number of payload bytes.
+ * After chunk_set_tag, chunks have the magic "PUF\x17" and carry the tag (4) after the length.
+ *
+ * Records which must not be split between chunks (see puf_read_sparse) are kept together with chunk_reserve, the
+ * rest of the chunk before them is filled with zeros.
+**/
+
+#define PUF_CHUNK_SIZE PUF_WORK_CHUNK_SIZE
+// Bytes queued between two polls of the UART DMA, so the next burst goes out while the chunk is encoded
+#define CHUNK_POLL 64
+// The resend loop ends if the host doesn't answer for this long
+#define RESEND_TIMEOUT_S 10
+
+// CRC32 of every nibble (reflected polynomial 0xEDB88320), two lookups per byte instead of a 1 KB table in L2
+static const uint32_t crc_nibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+static uint8_t* const chunk_buf=(uint8_t*)PUF_WORK_CHUNK;
+static uint32_t chunk_len, chunk_seq, chunk_addr, chunk_total;
+// Only chunks in [chunk_first, chunk_last) are sent, the others are just counted (see chunk_resend)
+static uint32_t chunk_first=0, chunk_last=0xFFFFFFFF;
+static uint32_t chunk_tag;
+static int chunk_tagged;
+// Bytes sent since chunk_begin, and when it was called
+static uint32_t chunk_sent, chunk_start_t;
+
+extern int uart_getc(uint32_t timeout);
+extern uint32_t uart_tx_wait_us;
+extern unsigned int uart_baud;
+extern void uart_drain(void);
+extern void uart_poll(void);
+
+/**
+ * Description: Continue a CRC32, start with 0
+**/
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+	crc = ~crc;
+	for (uint32_t i=0; i<len; i++)
+	{
+		crc ^= data[i];
+		crc = crc_nibble[crc & 0xF] ^ (crc >> 4);
+		crc = crc_nibble[crc & 0xF] ^ (crc >> 4);
+	}
+	return ~crc;
+}
+
+/**
+ * Description: Send raw bytes, through the ring to the first core while the second one encodes (see pipe.c)
+ *
+ * Input: data, len
+**/
+static void chunk_output(const uint8_t* data, uint32_t len)
+{
+	if (PIPE.active)
+		pipe_write(data, len);
+	else
+		putBinary(data, len);
+}
+
+/**
+ * Description: Send a chunk of the given payload
+ *
+ * Input: seq, addr, data, len
+**/
+void chunk_send(uint32_t seq, uint32_t addr, const uint8_t* data, uint32_t len)
+{
+	uint8_t header[18] = {
+		'P', 'U', 'F', chunk_tagged ? 0x17 : 0x16,
+		seq >> 24, seq >> 16, seq >> 8, seq,
+		addr >> 24, addr >> 16, addr >> 8, addr,
+		len >> 8, len,
+		chunk_tag >> 24, chunk_tag >> 16, chunk_tag >> 8, chunk_tag
+	};
+	uint32_t header_len = chunk_tagged ? 18 : 14;
+	uint32_t crc = crc32_update(crc32_update(0, header + 4, header_len - 4), data, len);
+	uint8_t trailer[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+
+	chunk_output(header, header_len);
+	chunk_output(data, len);
+	chunk_output(trailer, 4);
+	chunk_sent += header_len + len + 4;
+}
+
+void chunk_begin()
+{
+	chunk_sent=0;
+	uart_tx_wait_us=0;
+	chunk_start_t=ST_CLO;
+	chunk_seq=0;
+	chunk_len=0;
+	chunk_tagged=0;
+}
+
+/**
+ * Description: Tag the chunks from the next one on
+ *
+ * Input: tag
+**/
+void chunk_set_tag(uint32_t tag)
+{
+	if (chunk_len>0)
+		chunk_flush();
+	chunk_tag=tag;
+	chunk_tagged=1;
+}
+
+/**
+ * Description: Send the current chunk if it was selected and start the next one
+**/
+void chunk_flush()
+{
+	if (chunk_seq>=chunk_first && chunk_seq<chunk_last)
+		chunk_send(chunk_seq, chunk_addr, chunk_buf, chunk_len);
+	chunk_seq++;
+	chunk_len=0;
+}
+
+/**
+ * Description: Make sure the next len bytes go into the same chunk, the chunk starts with addr if it's a new one
+ *
+ * Input: len, addr
+**/
+void chunk_reserve(uint32_t len, uint32_t addr)
+{
+	if (chunk_len+len>PUF_CHUNK_SIZE)
+	{
+		while (chunk_len<PUF_CHUNK_SIZE)
+			chunk_buf[chunk_len++]=0;
+		chunk_flush();
+	}
+	if (chunk_len==0)
+		chunk_addr=addr;
+}
+
+/**
+ * Description: Queue one byte after chunk_reserve
+ *
+ * Input: val
+**/
+void chunk_put_byte(uint8_t val)
+{
+	chunk_buf[chunk_len++]=val;
+	if (chunk_len==PUF_CHUNK_SIZE)
+		chunk_flush();
+	else if (chunk_len%CHUNK_POLL==0 && !PIPE.active)
+		uart_poll();
+}
+
+/**
+ * Description: Queue one PUF word, sent as soon as the chunk is full
+ *
+ * Input: addr, val
+**/
+void chunk_put_word(uint32_t addr, uint32_t val)
+{
+	if (chunk_len==0)
+		chunk_addr=addr;
+	chunk_buf[chunk_len++]=val >> 24;
+	chunk_buf[chunk_len++]=val >> 16;
+	chunk_buf[chunk_len++]=val >> 8;
+	chunk_buf[chunk_len++]=val;
+	if (chunk_len==PUF_CHUNK_SIZE)
+		chunk_flush();
+	else if (chunk_len%CHUNK_POLL==0 && !PIPE.active)
+		uart_poll();
+}
+
+/**
+ * Description: Send the last partial chunk and the end chunk
+**/
+void chunk_end()
+{
+	chunk_total = chunk_seq * PUF_CHUNK_SIZE + chunk_len;
+	if (chunk_len>0)
+		chunk_flush();
+	chunk_send(chunk_seq, chunk_total, chunk_buf, 0);
+}
+
+/**
+ * Description: Print what sending the readout has cost since chunk_begin, once the last bytes have left the ring.
+ * The time not spent waiting for the UART is what reading, CRC and output take per byte, the time the bytes need on
+ * the wire (10 bits each) compared to the total shows how well the UART was kept busy.
+**/
+void chunk_stats()
+{
+	uart_drain();
+	uint32_t total_t = ST_CLO - chunk_start_t;
+	uint32_t busy_t = total_t > uart_tx_wait_us ? total_t - uart_tx_wait_us : 0;
+	// Per kB instead of * 1000, which would overflow after 4 s
+	uint32_t per_byte = chunk_sent >= 1000 ? busy_t / (chunk_sent / 1000) : 0;
+	uint32_t byte_rate = uart_baud / 10;
+	uint32_t wire_ms = byte_rate ? chunk_sent / byte_rate * 1000 + chunk_sent % byte_rate * 1000 / byte_rate : 0;
+	uint32_t use = total_t >= 1000 ? wire_ms * 100 / (total_t / 1000) : 0;
+	printf("%d bytes sent in %d ms, %d ms waiting for the UART, %d ns CPU per byte, wire %d %% busy\n", chunk_sent,
+	       total_t / 1000, uart_tx_wait_us / 1000, per_byte, use > 100 ? 100 : use);
+}
+
+/**
+ * Description: Address of the n-th word read out from start_addr, skipping 0xCF000000 - 0xD0000000 like
+ * puf_read_all does
+ *
+ * Input: start_addr, end_addr, n
+**/
+uint32_t chunk_word_addr(uint32_t start_addr, uint32_t end_addr, uint32_t n)
+{
+	if (start_addr>=0xCF000000 && start_addr<0xD0000000)
+		start_addr=0xD0000000;
+	if (start_addr<0xCF000000)
+	{
+		uint32_t first=((end_addr<0xCF000000 ? end_addr : 0xCF000000) - start_addr) / 4;
+		if (n>=first)
+			return 0xD0000000 + (n-first)*4;
+	}
+	return start_addr + n*4;
+}
+
+/**
+ * Description: Read a request of two numbers like "<first chunk> <count>" up to the carriage return, echoed like
+ * the kernel does with parameters
+ *
+ * Output: 0 for an empty request or if the host stays silent
+**/
+int chunk_read_request(uint32_t* first, uint32_t* count)
+{
+	uint32_t value[2]={0, 0};
+	int field=0, digits=0;
+	for (;;)
+	{
+		int c=uart_getc(RESEND_TIMEOUT_S*1000000);
+		if (c<0)
+			return 0;
+		if (c=='\r')
+			break;
+		if (c>='0' && c<='9')
+		{
+			putchar(c);
+			value[field]=value[field]*10 + (c-'0');
+			digits++;
+		}
+		else if (c==' ' && field==0 && digits>0)
+		{
+			putchar(c);
+			field=1;
+		}
+	}
+	putchar('\n');
+	*first=value[0];
+	*count=value[1];
+	return field==1 && value[1]>0;
+}
+
+/**
+ * Description: Send chunks again on request until the host is satisfied. Refresh has to be enabled again, so the
+ * decayed image stays as it was read out. Every batch of chunks ends with the end chunk again.
+ * Without an encoder the chunks are plain words read again from their address. Otherwise the encoder runs again
+ * over the whole range and only the requested chunks are sent.
+ *
+ * Input: start_addr, end_addr, init_value, encode
+**/
+void chunk_resend(uint32_t start_addr, uint32_t end_addr, uint32_t init_value, puf_encoder encode)
+{
+	uint32_t first, count;
+	for (;;)
+	{
+		printf("Resend chunks|: ");
+		if (!chunk_read_request(&first, &count))
+			break;
+		if (encode)
+		{
+			chunk_first=first;
+			chunk_last=first+count;
+			pipe_encode(encode, start_addr, end_addr, init_value);
+			chunk_first=0;
+			chunk_last=0xFFFFFFFF;
+			continue;
+		}
+		for (uint32_t seq=first; seq<first+count && seq<chunk_seq; seq++)
+		{
+			uint32_t n=seq*(PUF_CHUNK_SIZE/4);
+			uint32_t len=0;
+			for (; len<PUF_CHUNK_SIZE; len+=4)
+			{
+				uint32_t addr=chunk_word_addr(start_addr, end_addr, n+len/4);
+				if (addr>=end_addr)
+					break;
+				uint32_t val=mmio_read32(addr);
+				chunk_buf[len]=val >> 24;
+				chunk_buf[len+1]=val >> 16;
+				chunk_buf[len+2]=val >> 8;
+				chunk_buf[len+3]=val;
+			}
+			chunk_send(seq, chunk_word_addr(start_addr, end_addr, n), chunk_buf, len);
+		}
+		chunk_send(chunk_seq, chunk_total, chunk_buf, 0);
+	}
+}
@@ -2,7 +2,10 @@
 #include "hardware.h"
 #include "PufAddress.h"
 
-
+/*
+ * The decay functions (see GPUfunc). pasr_decay runs them with the SDRAM in self refresh, so they may only use
+ * registers and the stack, never memory outside of L2.
+ */
 
 void add(uint32_t a, uint32_t b)
 {
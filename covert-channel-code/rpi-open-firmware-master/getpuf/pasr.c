@@ -0,0 +1,153 @@
+/**
+ * Decay with Partial Array Self Refresh instead of disabling refresh. The SDRAM goes into self refresh (standby of
+ * the controller, like in timing_init) with the banks (MR16) and segments (MR17) of the range masked, so the device
+ * itself keeps refreshing everything else, the code rows included. Nothing has to be refreshed by hand.
+ *
+ * PASR only applies in self refresh: the masks have no effect on the refresh commands of the controller, which
+ * refresh every bank as soon as it is up again. So nothing may access the SDRAM during the decay. The VPU runs from
+ * its L2 cache (see start.s), the ARM stalls on its next access until the controller is up again. The decay function
+ * runs in self refresh as well, it may only use registers and the stack (see function.c), puf_extract_pasr checks
+ * that the image and the stack are in L2 before.
+ *
+ * A row decays if its bank or its segment (the three most significant row bits) is masked. Banks and segments with
+ * rows of Refresh() are never masked, the rows of the range in both of them keep their refresh.
+ *
+ * Included by GetPuf.c after window.c, tests/pasr_test.c runs it against simulated controller registers.
+**/
+
+#define PASR_ROW_SIZE 0x1000
+// The L2 cache the VPU runs from (see start.s), the only memory it can reach in self refresh
+#define PASR_L2_SIZE 0x20000
+#define PASR_IN_L2(p) (((uint32_t)(p) & 0x3FFFFFFF) < PASR_L2_SIZE)
+
+extern unsigned int write_mr(unsigned int addr, unsigned int data, bool wait);
+void GPUfunc(int dcy_func);
+
+struct pasr_masks {
+	uint32_t bank;
+	uint32_t segment;
+	// Rows of the range, and those of them which keep their refresh
+	uint32_t rows;
+	uint32_t kept;
+};
+
+// Rows Refresh() reads besides MRList, first row and count
+static const unsigned long pasr_code_rows[][2] = {{0xc0000000, 15}, {0xc2002000, 4}, {0xcf000000, 4},
+	{PUF_WORK_POS, PUF_WORK_POS_SIZE/PASR_ROW_SIZE}};
+
+uint32_t pasr_bank(unsigned long addr, unsigned int add_mode)
+{
+	return add_mode==0 ? (addr>>26) & 7 : (addr>>12) & 7;
+}
+
+uint32_t pasr_segment(unsigned long addr, unsigned int add_mode)
+{
+	return add_mode==0 ? (addr>>23) & 7 : (addr>>26) & 7;
+}
+
+/**
+ * Description: The masks which stop the refresh of as much of the range as possible without stopping it for any
+ * code row
+ *
+ * Input: start_addr, end_addr, add_mode, m
+**/
+void pasr_choose_masks(unsigned long start_addr, unsigned long end_addr, unsigned int add_mode, struct pasr_masks* m)
+{
+	uint32_t code_banks=0, code_segments=0, banks=0, segments=0;
+	int length=PUF_MR_ROWS;
+	for (int i=0; i<length; i++)
+	{
+		code_banks|=1 << pasr_bank(MRList[i], add_mode);
+		code_segments|=1 << pasr_segment(MRList[i], add_mode);
+	}
+	for (int i=0; i<sizeof(pasr_code_rows)/sizeof(pasr_code_rows[0]); i++)
+	{
+		for (unsigned long k=0; k<pasr_code_rows[i][1]; k++)
+		{
+			unsigned long row=pasr_code_rows[i][0] + k*PASR_ROW_SIZE;
+			code_banks|=1 << pasr_bank(row, add_mode);
+			code_segments|=1 << pasr_segment(row, add_mode);
+		}
+	}
+
+	// The words read out, end_addr is left out
+	struct puf_segment seg[PUF_MAX_SEGMENTS];
+	int n=puf_segments(start_addr, end_addr-4, seg);
+	for (int i=0; i<n; i++)
+	{
+		for (unsigned long row=seg[i].start & ~(PASR_ROW_SIZE-1); row<seg[i].end; row+=PASR_ROW_SIZE)
+			banks|=1 << pasr_bank(row, add_mode);
+	}
+	m->bank=banks & ~code_banks;
+
+	// Segments only for the rows in banks which can't be masked, masking them stops the refresh in every bank
+	for (int i=0; i<n; i++)
+	{
+		for (unsigned long row=seg[i].start & ~(PASR_ROW_SIZE-1); row<seg[i].end; row+=PASR_ROW_SIZE)
+		{
+			if (!(m->bank & (1 << pasr_bank(row, add_mode))))
+				segments|=1 << pasr_segment(row, add_mode);
+		}
+	}
+	m->segment=segments & ~code_segments;
+
+	m->rows=0;
+	m->kept=0;
+	for (int i=0; i<n; i++)
+	{
+		for (unsigned long row=seg[i].start & ~(PASR_ROW_SIZE-1); row<seg[i].end; row+=PASR_ROW_SIZE)
+		{
+			m->rows++;
+			if (!(m->bank & (1 << pasr_bank(row, add_mode))) && !(m->segment & (1 << pasr_segment(row, add_mode))))
+				m->kept++;
+		}
+	}
+}
+
+/**
+ * Description: Set the masks, then put the SDRAM into self refresh and wait until the controller is down. The masks
+ * only take effect from here on.
+ *
+ * Input: m
+**/
+void pasr_enter(const struct pasr_masks* m)
+{
+	write_mr(LPDDR2_MR_PASR_BANK, m->bank, true);
+	write_mr(LPDDR2_MR_PASR_SEGMENT, m->segment, true);
+
+	SD_CS = (SD_CS & ~(SD_CS_DEL_KEEP_SET|SD_CS_DPD_SET|SD_CS_RESTRT_SET)) | SD_CS_STBY_SET;
+	for (;;) if ((SD_CS & SD_CS_SDUP_SET) == 0) break;
+}
+
+/**
+ * Description: Decay for decay_time seconds in self refresh with the masks set. dcy_func runs every nfreq * 50 us,
+ * back to back if nfreq is 0, without touching the SDRAM. Refresh is back on for every row once timing_init has
+ * restarted the controller and pasr_clear has reset the masks.
+ *
+ * Input: m, decay_time, dcy_func (0 for none), nfreq
+**/
+void pasr_decay(const struct pasr_masks* m, int decay_time, int dcy_func, int nfreq)
+{
+	pasr_enter(m);
+
+	uint32_t t0=ST_CLO, next=0;
+	uint32_t decay_us=decay_time*1000000;
+	while ((ST_CLO-t0) < decay_us)
+	{
+		if (dcy_func && (ST_CLO-t0) >= next)
+		{
+			GPUfunc(dcy_func);
+			next+=nfreq*50;
+		}
+	}
+}
+
+/**
+ * Description: Refresh every bank and segment again in self refresh, once the controller is up. Auto refresh
+ * covers them anyway, this is for the next time the SDRAM goes into self refresh.
+**/
+void pasr_clear()
+{
+	write_mr(LPDDR2_MR_PASR_BANK, 0, true);
+	write_mr(LPDDR2_MR_PASR_SEGMENT, 0, true);
+}
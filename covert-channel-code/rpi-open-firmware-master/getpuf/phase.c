@@ -0,0 +1,60 @@
+/**
+ * Timing of the phases of a measurement from ST_CLO. Every puf_extract* starts it and ends each of its phases, the
+ * readouts send it as a trailer line right before "|$", after the chunks sent again:
+ *   Phases: <phase>=<us> ... total=<us>
+ * with the phases in the order they ran, e.g. init, decay, refresh, transmit and resend. SerialReader writes them
+ * next to the dump. Phases a mode doesn't have are left out, transmit includes the reading of the cells wherever
+ * they are encoded while being sent.
+ *
+ * The trailer goes before "|$" rather than after it: SerialReader closes the measurement at "|$", a line after it
+ * would be taken for the output of the next job. "|&<cells>" doesn't end the readout either, the chunks missed by
+ * the host are sent again after it.
+**/
+
+#define PHASE_MAX 8
+
+static const char* phase_names[PHASE_MAX];
+static uint32_t phase_us[PHASE_MAX];
+static uint32_t phase_count, phase_t0, phase_t;
+static int phase_active=0;
+
+/**
+ * Description: Start timing a measurement
+**/
+void phase_start()
+{
+	phase_count=0;
+	phase_t0=ST_CLO;
+	phase_t=phase_t0;
+	phase_active=1;
+}
+
+/**
+ * Description: End the current phase, the next one starts now
+ *
+ * Input: name
+**/
+void phase_end(const char* name)
+{
+	uint32_t now=ST_CLO;
+	if (phase_active && phase_count<PHASE_MAX)
+	{
+		phase_names[phase_count]=name;
+		phase_us[phase_count++]=now-phase_t;
+	}
+	phase_t=now;
+}
+
+/**
+ * Description: Send the trailer, nothing if the measurement wasn't timed
+**/
+void phase_trailer()
+{
+	if (!phase_active)
+		return;
+	printf("Phases:");
+	for (uint32_t i=0; i<phase_count; i++)
+		printf(" %s=%d", phase_names[i], phase_us[i]);
+	printf(" total=%d\n", phase_t-phase_t0);
+	phase_active=0;
+}
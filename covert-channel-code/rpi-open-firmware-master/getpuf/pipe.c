@@ -0,0 +1,166 @@
+/**
+ * Readout over both VPU cores. The second core runs the encoder (reading the PUF, encoding and framing the chunks,
+ * see chunk.c) and puts the frames into a ring buffer, the first one only hands them to the UART. Reading then
+ * overlaps with sending completely and the readout is bound by the link alone.
+ *
+ * Each core has an L1 data cache of its own (DC0 and DC1 of L1_D_CONTROL, see vpu_l1_cache_ctrl.h). What both cores
+ * touch while the encoder runs lies in pipe_mem, accessed through the L2-only alias. The rest of the encoder state
+ * (chunk.c and the readouts) is handed over by flushing the data and bss from the L1 cache of one core before the
+ * other one goes on: the first core before it starts the job and once it's done, the second one before and after it
+ * runs the encoder. Meanwhile the first core only writes the UART state of romstage.c, whose bss starts on a cache
+ * line like the one of arm_monitor.c (uart_dma_cb, pipe_mem), so none of those lines is shared with the second core.
+**/
+
+// Run the encoders on the second core, 0 reads out on one core like before
+#define PUF_DUAL_VPU 1
+
+// Ring of encoded bytes between the cores, a power of two
+#define PIPE_RING_SIZE 512
+#define PIPE_RING_MASK (PIPE_RING_SIZE - 1)
+// Bytes handed to the UART at once
+#define PIPE_PIECE 256
+// Microseconds the second core has to come up
+#define PIPE_START_TIMEOUT 100000
+
+#define PIPE_IDLE 0
+#define PIPE_RUN  1
+#define PIPE_DONE 2
+
+typedef uint32_t (*puf_encoder)(unsigned long, unsigned long, unsigned int);
+
+extern void _start_vpu1();
+extern uint32_t _erodata, _end;
+
+struct pipe_shared {
+	// Free running, in is only written by the second core and out by the first one
+	uint32_t in, out;
+	uint32_t state;
+	uint32_t vpu1_up;
+	// Set while the second core encodes, chunk_send writes to the ring then
+	uint32_t active;
+	puf_encoder encoder;
+	unsigned long start_addr, end_addr;
+	unsigned int init_value;
+	uint32_t result;
+	uint8_t ring[PIPE_RING_SIZE];
+};
+
+static struct pipe_shared pipe_mem __attribute__((aligned(32)));
+
+#define PIPE (*(volatile struct pipe_shared*)L2_ALIAS(&pipe_mem))
+
+/**
+ * Description: Write back and drop the data and bss in the L1 data cache of one core
+ *
+ * Input: flush - L1_D_CONTROL_DC0_FLUSH_SET for the first core, L1_D_CONTROL_DC1_FLUSH_SET for the second one
+**/
+static void pipe_flush(uint32_t flush)
+{
+	L1_D_FLUSH_S=(uint32_t)&_erodata & L1_D_FLUSH_S_MASK;
+	L1_D_FLUSH_E=((uint32_t)&_end+31) & L1_D_FLUSH_E_MASK;
+	L1_D_CONTROL|=flush;
+	while (L1_D_CONTROL & flush);
+}
+
+/**
+ * Description: Main loop of the second core, entered from _start_vpu1 (start.s). Runs one encoder after the other.
+**/
+void vpu1_main()
+{
+	PIPE.vpu1_up=1;
+	for (;;)
+	{
+		while (PIPE.state!=PIPE_RUN);
+		// Lines of an earlier job may be stale, the first core has written back what it set up
+		pipe_flush(L1_D_CONTROL_DC1_FLUSH_SET);
+		PIPE.result=PIPE.encoder(PIPE.start_addr, PIPE.end_addr, PIPE.init_value);
+		pipe_flush(L1_D_CONTROL_DC1_FLUSH_SET);
+		PIPE.state=PIPE_DONE;
+	}
+}
+
+/**
+ * Description: Start the second core, the readout stays on the first one if it doesn't come up
+**/
+void pipe_start()
+{
+#if PUF_DUAL_VPU
+	IC1_WAKEUP=(uint32_t)_start_vpu1;
+	uint32_t tin=ST_CLO;
+	while (!PIPE.vpu1_up && ST_CLO-tin<PIPE_START_TIMEOUT);
+	if (PIPE.vpu1_up)
+		printf("Second VPU core up, readouts are encoded on it\n");
+	else
+		printf("Second VPU core not responding, readouts stay on one core\n");
+#endif
+}
+
+/**
+ * Description: Queue encoded bytes on the second core, waiting while the ring is full
+ *
+ * Input: data, len
+**/
+void pipe_write(const uint8_t* data, uint32_t len)
+{
+	while (len>0)
+	{
+		uint32_t in=PIPE.in;
+		uint32_t space=PIPE_RING_SIZE-(in-PIPE.out);
+		if (space==0)
+			continue;
+		uint32_t pos=in & PIPE_RING_MASK;
+		uint32_t n=PIPE_RING_SIZE-pos;
+		if (n>space)
+			n=space;
+		if (n>len)
+			n=len;
+		memcpy((uint8_t*)&PIPE.ring[pos], data, n);
+		data+=n;
+		len-=n;
+		PIPE.in=in+n;
+	}
+}
+
+/**
+ * Description: Run an encoder on the second core and send what it puts into the ring until it's done. Runs it
+ * here if the second core isn't up.
+ *
+ * Input: encode, start_addr, end_addr, init_value
+ *
+ * Return: What the encoder returns
+**/
+uint32_t pipe_encode(puf_encoder encode, unsigned long start_addr, unsigned long end_addr, unsigned int init_value)
+{
+	if (!PIPE.vpu1_up)
+		return encode(start_addr, end_addr, init_value);
+
+	PIPE.in=0;
+	PIPE.out=0;
+	PIPE.encoder=encode;
+	PIPE.start_addr=start_addr;
+	PIPE.end_addr=end_addr;
+	PIPE.init_value=init_value;
+	PIPE.active=1;
+	pipe_flush(L1_D_CONTROL_DC0_FLUSH_SET);
+	PIPE.state=PIPE_RUN;
+	while (PIPE.state!=PIPE_DONE || PIPE.out!=PIPE.in)
+	{
+		uint32_t out=PIPE.out;
+		uint32_t queued=PIPE.in-out;
+		if (queued==0)
+			continue;
+		uint32_t pos=out & PIPE_RING_MASK;
+		uint32_t n=PIPE_RING_SIZE-pos;
+		if (n>queued)
+			n=queued;
+		if (n>PIPE_PIECE)
+			n=PIPE_PIECE;
+		putBinary((const uint8_t*)&PIPE.ring[pos], n);
+		PIPE.out=out+n;
+	}
+	// What the encoder left in chunk.c and the readouts
+	pipe_flush(L1_D_CONTROL_DC0_FLUSH_SET);
+	PIPE.active=0;
+	PIPE.state=PIPE_IDLE;
+	return PIPE.result;
+}
@@ -0,0 +1,162 @@
+/**
+ * Scheduler of the decay with refresh disabled. The code rows (and the stages read so far, see puf_keep_stages) are
+ * refreshed from the interrupt of a system timer compare channel, at fixed times after the start of the decay, and
+ * the decay function runs in bursts on its own period in between. Nothing drifts with the time the bursts take.
+ * Times are kept as offsets from the start, so decays up to the 71 minutes of ST_CLO work.
+**/
+
+// Interval of the refresh of the code rows
+#define PUF_REFRESH_US 64000
+
+// System timer compare channel of the scheduler, its interrupt has the same number
+#define SCHED_TIMER   ST_C2
+#define SCHED_MATCH   (1 << 2)
+
+void Refresh();
+void GPUfunc(int dcy_func);
+void puf_keep_stages(uint32_t count);
+
+static volatile int sched_active=0;
+static uint32_t sched_t0, sched_burst_us;
+// Offsets from sched_t0 of the next refresh, the next burst and the end of the current wait
+static uint32_t sched_refresh_at, sched_burst_at, sched_end_at;
+static volatile int sched_burst_due, sched_done;
+// Stages kept alive along with the code rows
+static volatile uint32_t sched_keep;
+static volatile uint32_t sched_refreshes, sched_worst_jitter;
+static uint32_t sched_bursts, sched_burst_t;
+
+/**
+ * Description: Offset of the next event
+**/
+static uint32_t sched_next()
+{
+	uint32_t next=sched_refresh_at;
+	if (sched_burst_us && sched_burst_at<next)
+		next=sched_burst_at;
+	if (!sched_done && sched_end_at<next)
+		next=sched_end_at;
+	return next;
+}
+
+/**
+ * Description: Handle every event which is due and set the compare register to the next one, with interrupts
+ * disabled
+**/
+static void sched_run()
+{
+	for (;;)
+	{
+		uint32_t now=ST_CLO-sched_t0;
+		if (now>=sched_refresh_at)
+		{
+			uint32_t jitter=now-sched_refresh_at;
+			if (jitter>sched_worst_jitter)
+				sched_worst_jitter=jitter;
+			Refresh();
+			puf_keep_stages(sched_keep);
+			sched_refreshes++;
+			sched_refresh_at+=PUF_REFRESH_US;
+		}
+		if (sched_burst_us && now>=sched_burst_at)
+		{
+			sched_burst_due=1;
+			// Bursts which didn't fit are skipped, the next one stays on the period
+			while (sched_burst_at<=now)
+				sched_burst_at+=sched_burst_us;
+		}
+		if (!sched_done && now>=sched_end_at)
+			sched_done=1;
+
+		uint32_t next=sched_next();
+		SCHED_TIMER=sched_t0+next;
+		// Passed while setting it, the match would only come after ST_CLO wraps
+		if (ST_CLO-sched_t0<next)
+			break;
+	}
+}
+
+/**
+ * Description: Handle the compare interrupt, called first by sleh_irq
+ *
+ * Return: 1 if the interrupt was the scheduler's
+**/
+int sched_irq()
+{
+	if (!(ST_CS & SCHED_MATCH))
+		return 0;
+	ST_CS=SCHED_MATCH;
+	if (sched_active)
+		sched_run();
+	return 1;
+}
+
+/**
+ * Description: Start refreshing from the interrupt, every PUF_REFRESH_US after t0
+ *
+ * Input: t0, burst_us - period of the bursts of the decay function, 0 to run it back to back
+**/
+void sched_start(uint32_t t0, uint32_t burst_us)
+{
+	sched_t0=t0;
+	sched_burst_us=burst_us;
+	sched_refresh_at=PUF_REFRESH_US;
+	sched_burst_at=burst_us;
+	sched_end_at=0;
+	sched_burst_due=0;
+	sched_done=1;
+	sched_keep=0;
+	sched_refreshes=0;
+	sched_worst_jitter=0;
+	sched_bursts=0;
+	sched_burst_t=0;
+	__asm__ __volatile__ ("di" :::);
+	ST_CS=SCHED_MATCH;
+	sched_active=1;
+	sched_run();
+	__asm__ __volatile__ ("ei" :::);
+}
+
+/**
+ * Description: Sleep until end microseconds after the start, running the decay function whenever a burst is due
+ *
+ * Input: end, dcy_func (0 for none), keep - stages to keep alive from now on
+**/
+void sched_wait(uint32_t end, int dcy_func, uint32_t keep)
+{
+	__asm__ __volatile__ ("di" :::);
+	sched_keep=keep;
+	sched_end_at=end;
+	sched_done=0;
+	sched_run();
+	__asm__ __volatile__ ("ei" :::);
+
+	while (!sched_done)
+	{
+		if (dcy_func && (sched_burst_us==0 || sched_burst_due))
+		{
+			sched_burst_due=0;
+			uint32_t tin=ST_CLO;
+			GPUfunc(dcy_func);
+			sched_burst_t=ST_CLO-tin;
+			sched_bursts++;
+		}
+		else
+			__asm__ __volatile__ ("sleep" :::);
+	}
+}
+
+/**
+ * Description: Stop refreshing from the interrupt and print how exactly it was kept
+**/
+void sched_stop()
+{
+	sched_active=0;
+	printf("%d refreshes every %d ms, worst jitter %d us\n", sched_refreshes, PUF_REFRESH_US / 1000,
+	       sched_worst_jitter);
+	if (sched_bursts!=0)
+	{
+		printf("function_count = %d\n", sched_bursts);
+		printf("function time = %d us\n", sched_burst_t);
+	}
+}
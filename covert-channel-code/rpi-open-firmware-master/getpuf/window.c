@@ -0,0 +1,71 @@
+/**
+ * The PUF windows of the SDRAM and the rows in them which hold code, kept alive during every decay.
+**/
+
+/**
+ * Description: Manually refresh address segments stored with code
+ * during the decay time
+ *
+ * Input: decay_time
+**/
+unsigned long MRList[]={
+	0xc0023000,
+	0xc0024000,
+	0xc0123000,
+	0xc0172000,
+	0xc2000000,
+	0xc2001000,
+
+};
+
+#define PUF_MR_ROWS (sizeof(MRList)/sizeof(MRList[0]))
+
+// The PUF windows, the rows in between (from CF000000) hold code and are refreshed during the decay.
+// Unlike the former word by word loop, which also wrote the word at 0xCF000000 (addr<=0xcf000000) and the word after
+// every row of MRList, the first window ends before 0xCF000000 like in every readout. Neither of those words was ever
+// read out, and 0xCF000000 is the first of the rows Refresh() keeps alive.
+#define PUF_WINDOWS 2
+// Each window can be split by every row of MRList
+#define PUF_MAX_SEGMENTS (PUF_WINDOWS + PUF_MR_ROWS)
+
+struct puf_segment {
+	unsigned long start;
+	unsigned long end;
+};
+
+/**
+ * Description: Split an address range into the contiguous segments which are written, everything outside of the
+ * PUF windows and the rows of MRList (in ascending order) left out
+ * Input: start_addr, end_addr (inclusive), seg (PUF_MAX_SEGMENTS, end exclusive)
+ * Output: Number of segments
+**/
+int puf_segments(unsigned long start_addr, unsigned long end_addr, struct puf_segment* seg)
+{
+	static const unsigned long window[PUF_WINDOWS][2] = {{0xc3000000, 0xcf000000}, {0xd0000000, 0xe0000000}};
+	int length = PUF_MR_ROWS;
+	int n = 0;
+	for (int w = 0; w < PUF_WINDOWS; w++)
+	{
+		unsigned long start = start_addr > window[w][0] ? start_addr : window[w][0];
+		// Up to the end of the word holding end_addr, the windows end on a word boundary
+		unsigned long end = end_addr < window[w][1] ? (end_addr & ~3UL) + 4 : window[w][1];
+		for (int k = 0; k < length && start < end; k++)
+		{
+			unsigned long mr = MRList[k];
+			if (mr + 0x1000 <= start || mr >= end)
+				continue;
+			if (mr > start)
+			{
+				seg[n].start = start;
+				seg[n++].end = mr;
+			}
+			start = mr + 0x1000;
+		}
+		if (start < end)
+		{
+			seg[n].start = start;
+			seg[n++].end = end;
+		}
+	}
+	return n;
+}
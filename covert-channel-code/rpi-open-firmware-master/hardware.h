@@ -45,6 +45,13 @@ that are missing from the release. This is also used by ARM.
  */
 #include "broadcom/bcm2708_chip/aux_io.h"
 #include "broadcom/bcm2708_chip/testbus.h"
+#include "broadcom/bcm2708_chip/axi_dma_top.h"
+
+/*
+ * Bus address of p through the L2-only alias, past the L1 cache of either
+ * core: for data the DMA engine or the other core reads.
+ */
+#define L2_ALIAS(p) (0x80000000 | ((uint32_t)(p) & 0x3FFFFFFF))
 
 #define RAM_SIZE_1GB 0
 #define RAM_SIZE_512MB 1
@@ -65,6 +72,8 @@ that are missing from the release. This is also used by ARM.
 #define LPDDR2_MR_REV_2            7
 #define LPDDR2_MR_METRICS          8
 #define LPDDR2_MR_CALIBRATION      10
+#define LPDDR2_MR_PASR_BANK        16
+#define LPDDR2_MR_PASR_SEGMENT     17
 
 #define CM_SRC_GND			0
 #define CM_SRC_OSC			1
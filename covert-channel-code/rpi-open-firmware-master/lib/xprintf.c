@@ -14,6 +14,7 @@
 #include "xprintf.h"
 
 extern void uart_putc(unsigned int ch);
+extern void uart_write(const unsigned char* buf, unsigned int len);
 
 /*----------------------------------------------*/
 /* Put a character                              */
@@ -35,6 +36,15 @@ int putcharBinary (int c)
 	uart_putc(c);
 }
 
+/*----------------------------------------------*/
+/* Put a buffer of binary characters            */
+/*----------------------------------------------*/
+
+void putBinary (const void* buff, unsigned int len)
+{
+	uart_write((const unsigned char*)buff, len);
+}
+
 /*----------------------------------------------*/
 /* Put a null-terminated string                 */
 /*----------------------------------------------*/
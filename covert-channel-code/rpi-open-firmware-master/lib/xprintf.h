@@ -21,6 +21,7 @@ extern "C" {
 
 int putchar (int c);
 int putcharBinary (int c);
+void putBinary (const void* buff, unsigned int len);
 int puts (const char* str);
 int printf (const char* fmt, ...) __attribute__ ((format (printf, 1, 2)));
 int printfBinary (const char* fmt, ...) __attribute__ ((format (printfBinary, 1, 2)));
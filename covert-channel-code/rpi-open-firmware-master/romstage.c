@@ -28,17 +28,92 @@ uint32_t g_CPUID;
 #define UART_CR     (UART_BASE+0x30)
 #define UART_ICR    (UART_BASE+0x44)
 
+#define UART_DEFAULT_BAUD 115200
+// Once a baud rate is negotiated, the UART is clocked straight from the 19.2 MHz crystal instead of ~3 MHz
+#define UART_FAST_CLOCK   19200000
+#define UART_MAX_ERROR    50 // 1/50 = 2 %
+
+// RTS/CTS on GPIO 17/16. CTS is pulled down, so a sender without the wires still transmits
+#define UART_FLOW_CONTROL 1
+
+#if UART_FLOW_CONTROL
+#define UART_CR_ENABLE    0xC301 // CTSEN | RTSEN | RXE | TXE | UARTEN
+#else
+#define UART_CR_ENABLE    0x301 // RXE | TXE | UARTEN
+#endif
+
+// Depth of the PL011 transmit FIFO
+#define UART_TX_FIFO 16
+
+// Raw bytes go out through DMA channel 0 from a ring buffer, so the readout can go on while they are sent
+#define UART_TX_DMA 1
+
+// Microseconds uart_write has spent waiting for the FIFO or the ring to drain
+uint32_t uart_tx_wait_us;
+// Baud rate in use, for the wire utilisation after a readout
+unsigned int uart_baud;
+
+#if UART_TX_DMA
+#include "uart_dma.c"
+#else
+void uart_poll(void) {
+}
+
+void uart_drain(void) {
+}
+
+/**
+Description: Send raw bytes, filling the whole FIFO once it has run empty instead of checking it before every byte.
+The last byte is still in the shift register when the FIFO reports empty, so the line doesn't go idle.
+Input: buf, len
+**/
+void uart_write(const unsigned char* buf, unsigned int len) {
+	while (len > 0) {
+		if (!(UART_MSR & 0x80)) { // TXFE
+			uint32_t start = ST_CLO;
+			while (!(UART_MSR & 0x80));
+			uart_tx_wait_us += ST_CLO - start;
+		}
+		unsigned int n = len < UART_TX_FIFO ? len : UART_TX_FIFO;
+		len -= n;
+		while (n-- > 0)
+			UART_RBRTHRDLL = *buf++;
+	}
+}
+#endif
+
 void uart_putc(unsigned int ch) {
+	uart_drain();
 	while(UART_MSR & 0x20);
 	UART_RBRTHRDLL = ch;
 }
 
+/**
+Description: Receive one character, once the kernel has stopped listening.
+Input: timeout - microseconds to wait at most
+Output: the character, -1 on timeout
+**/
+int uart_getc(uint32_t timeout) {
+	uint32_t start = ST_CLO;
+	while(UART_MSR & 0x10) { // RXFE
+		if ((ST_CLO - start) > timeout)
+			return -1;
+	}
+	return UART_RBRTHRDLL & 0xFF;
+}
+
 void uart_init(void) {
 	unsigned int ra = GP_FSEL1;
 	ra &= ~(7 << 12);
 	ra |= 4 << 12;
 	ra &= ~(7 << 15);
 	ra |= 4 << 15;
+#if UART_FLOW_CONTROL
+	ra &= ~(7 << 18);
+	ra |= 7 << 18; // GPIO 16: ALT3 = CTS0
+	ra &= ~(7 << 21);
+	ra |= 7 << 21; // GPIO 17: ALT3 = RTS0
+#endif
 	GP_FSEL1 = ra;
 
 	mmio_write32(UART_CR, 0);
@@ -49,6 +124,15 @@ void uart_init(void) {
 	udelay(150);
 	GP_PUDCLK0 = 0;
 
+#if UART_FLOW_CONTROL
+	GP_PUD = 1; // pull down
+	udelay(150);
+	GP_PUDCLK0 = 1 << 16;
+	udelay(150);
+	GP_PUDCLK0 = 0;
+	GP_PUD = 0;
+#endif
+
 	CM_UARTDIV = CM_PASSWORD | 0x6666; // ~3 MHz
 	CM_UARTCTL = CM_PASSWORD | CM_SRC_OSC | CM_UARTCTL_FRAC_SET | CM_UARTCTL_ENAB_SET;
 
@@ -63,7 +147,52 @@ void uart_init(void) {
 	mmio_write32(UART_FBRD, 40);
 
 	mmio_write32(UART_LCRH, 0x70); // WLEN_8 | FEN
-	mmio_write32(UART_CR, 0x301); // RXE | TXE | UARTEN
+	mmio_write32(UART_CR, UART_CR_ENABLE);
+	uart_baud = UART_DEFAULT_BAUD;
+
+#if UART_TX_DMA
+	DMA_ENABLE |= DMA_ENABLE_EN0_SET;
+	mmio_write32(UART_DMACR, UART_DMACR_TXDMAE);
+#endif
+}
+
+/**
+Description: Switches the UART to the given baud rate, requested by the kernel during the baud rate negotiation.
+			 Waits until everything queued is sent. If the rate can't be generated within 2 %, the UART goes back
+			 to 115200 baud.
+Input: baud - requested baud rate
+Output: baud rate in use afterwards
+**/
+unsigned int uart_set_baud(unsigned int baud) {
+	// BRD * 64 = clock / (16 * baud) * 64, rounded
+	unsigned int brd = baud == 0 ? 0 : (UART_FAST_CLOCK * 4 + baud / 2) / baud;
+	unsigned int actual = brd < 64 || brd >= (1 << 22) ? 0 : UART_FAST_CLOCK * 4 / brd;
+	unsigned int error = actual > baud ? actual - baud : baud - actual;
+
+	uart_drain();
+	while(UART_MSR & 0x08); // BUSY
+
+	if (actual == 0 || error * UART_MAX_ERROR > baud) {
+		uart_init();
+		return UART_DEFAULT_BAUD;
+	}
+
+	mmio_write32(UART_CR, 0);
+
+	CM_UARTCTL = CM_PASSWORD | CM_SRC_OSC | CM_UARTCTL_FRAC_SET;
+	while(CM_UARTCTL & CM_UARTCTL_BUSY_SET);
+	CM_UARTDIV = CM_PASSWORD | (1 << 12);
+	CM_UARTCTL = CM_PASSWORD | CM_SRC_OSC | CM_UARTCTL_FRAC_SET | CM_UARTCTL_ENAB_SET;
+
+	mmio_write32(UART_ICR, 0x7FF);
+	mmio_write32(UART_IBRD, brd >> 6);
+	mmio_write32(UART_FBRD, brd & 0x3F);
+
+	// LCRH has to be written after the divisors to latch them
+	mmio_write32(UART_LCRH, 0x70); // WLEN_8 | FEN
+	mmio_write32(UART_CR, UART_CR_ENABLE);
+	uart_baud = baud;
+	return baud;
 }
 
 void switch_vpu_to_pllc() {
@@ -144,8 +273,8 @@ int _main(unsigned int cpuid, unsigned int load_address) {
 	    set_interrupt(i, 0, 1);
 	}
 
-	IC0_VADDR = 0x1B000;
-	IC1_VADDR = 0x1B000;
+	IC0_VADDR = 0x1E000;
+	IC1_VADDR = 0x1E000;
 
 	__asm__ volatile("ei");
 
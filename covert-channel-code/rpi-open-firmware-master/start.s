@@ -46,8 +46,8 @@ _start:
 	version r0
 	mov r5, r0
 
-	/* vectors */
-	mov r3, #0x1B000
+	/* vectors, right below the stacks (see linker.lds) */
+	mov r3, #0x1E000
 	mov r1, r3
 
 	/*
@@ -104,11 +104,12 @@ L_setup_hw_irq:
 
 	/*
 	 * load the interrupt and normal stack pointers. these
-	 * are chosen to be near the top of the available cache memory
+	 * are chosen to be near the top of the available cache memory,
+	 * the image has to end below the vectors (see linker.lds)
 	 */
 
-	mov r28, #0x1D000 
-	mov sp, #0x1C000
+	mov r28, #0x1F800
+	mov sp, #0x1F000
 
 	/* jump to C code */
 	mov r0, r5
@@ -116,6 +117,20 @@ L_setup_hw_irq:
 
 	bl _main
 
+/*
+ * entry of the second core, woken up by pipe_start (getpuf/pipe.c). its
+ * stack is above the interrupt stack of the first core
+ */
+
+.globl _start_vpu1
+.align 2
+_start_vpu1:
+	mov sp, #0x20000
+	bl vpu1_main
+L_vpu1_halt:
+	sleep
+	b L_vpu1_halt
+
 /************************************************************
  * Exception Handling
  *********************************************************** */
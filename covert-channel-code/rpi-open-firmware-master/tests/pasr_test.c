@@ -0,0 +1,190 @@
+/**
+ * Host test of the PASR decay (getpuf/pasr.c) against simulated SDRAM controller registers, run by "make test":
+ * the MR16/MR17 masks chosen for a few ranges, and the order of the mode register writes and of SD_CS when the
+ * SDRAM goes into self refresh. Every failed check is printed with its line and the test exits with 1.
+**/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Only the bit definitions, the registers are simulated below
+#include "broadcom/bcm2708_chip/sdc_ctrl.h"
+#undef SD_CS
+#include "getpuf/PufAddress.h"
+
+// As in hardware.h
+#define LPDDR2_MR_PASR_BANK        16
+#define LPDDR2_MR_PASR_SEGMENT     17
+
+static int failures=0;
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, what);
+		++failures;
+	}
+}
+
+/* The controller: every access of SD_CS first takes in what was written since the last one, the controller goes
+ * down a few polls after standby was requested. Everything that happens is logged in order. */
+
+#define SIM_LOG_SIZE 16
+#define SIM_DOWN_POLLS 3
+
+static char sim_log[SIM_LOG_SIZE][32];
+static int sim_logged;
+static uint32_t sim_cs, sim_cs_seen;
+static int sim_down_in, sim_polls_down;
+static uint32_t sim_clo;
+static int sim_func_calls, sim_func_calls_up;
+
+static void sim_event(const char* fmt, uint32_t a, uint32_t b)
+{
+	if (sim_logged<SIM_LOG_SIZE)
+		snprintf(sim_log[sim_logged++], sizeof(sim_log[0]), fmt, a, b);
+}
+
+static void sim_reset(uint32_t cs)
+{
+	sim_logged=0;
+	sim_cs=sim_cs_seen=cs;
+	sim_down_in=sim_polls_down=0;
+	sim_clo=0;
+	sim_func_calls=sim_func_calls_up=0;
+}
+
+static uint32_t* sim_sd_cs()
+{
+	if (sim_cs!=sim_cs_seen)
+	{
+		sim_event("SD_CS=%08X", sim_cs, 0);
+		if ((sim_cs & SD_CS_STBY_SET) && !(sim_cs_seen & SD_CS_STBY_SET))
+			sim_down_in=SIM_DOWN_POLLS;
+		sim_cs_seen=sim_cs;
+	}
+	if (!(sim_cs & SD_CS_SDUP_SET))
+		sim_polls_down++;
+	if (sim_down_in && --sim_down_in==0)
+	{
+		sim_cs&=~SD_CS_SDUP_SET;
+		sim_cs_seen=sim_cs;
+		sim_event("down", 0, 0);
+	}
+	return &sim_cs;
+}
+
+#define SD_CS (*sim_sd_cs())
+// Every read takes a millisecond
+#define ST_CLO (sim_clo+=1000)
+
+unsigned int write_mr(unsigned int addr, unsigned int data, bool wait)
+{
+	// A mode register write can't get through in self refresh, it would never be done
+	CHECK(sim_cs & SD_CS_SDUP_SET);
+	sim_event("MR%d=%02X", addr, data);
+	return 0;
+}
+
+void GPUfunc(int dcy_func)
+{
+	sim_func_calls++;
+	if (sim_cs & SD_CS_SDUP_SET)
+		sim_func_calls_up++;
+}
+
+#include "getpuf/window.c"
+#include "getpuf/pasr.c"
+
+static void test_masks(unsigned long start, unsigned long end, unsigned int add_mode, uint32_t bank, uint32_t segment,
+                       uint32_t rows, uint32_t kept)
+{
+	struct pasr_masks m;
+	pasr_choose_masks(start, end, add_mode, &m);
+	CHECK(m.bank==bank);
+	CHECK(m.segment==segment);
+	CHECK(m.rows==rows);
+	CHECK(m.kept==kept);
+	if (m.bank!=bank || m.segment!=segment || m.rows!=rows || m.kept!=kept)
+		fprintf(stderr, "  0x%08lX - 0x%08lX mode %d: bank 0x%02X, segment 0x%02X, %d of %d rows kept\n", start, end,
+		        add_mode, m.bank, m.segment, m.kept, m.rows);
+}
+
+/* The code rows lie in BRC banks 0 and 3 and segments 0, 4 and 6, in RBC in every bank and in segments 0 and 3. */
+static void test_choose_masks()
+{
+	// BRC bank 4 alone, all of it decays
+	test_masks(0xD0000000, 0xD1000000, 0, 0x10, 0x00, 4096, 0);
+	// BRC bank 0 holds code, only segment 7 can be masked, segment 6 holds code as well
+	test_masks(0xC3000000, 0xC4000000, 0, 0x00, 0x80, 4096, 2048);
+	// Across the rows from 0xCF000000: bank 4 is masked, of code bank 3 segment 5 only
+	test_masks(0xCE000000, 0xD0400000, 0, 0x10, 0x20, 5120, 2048);
+	// RBC: no bank can be masked, segment 4 can
+	test_masks(0xD0000000, 0xD0100000, 1, 0x00, 0x10, 256, 0);
+	// RBC segment 3 holds code, nothing decays
+	test_masks(0xCC000000, 0xCC100000, 1, 0x00, 0x00, 256, 256);
+}
+
+static void test_segments()
+{
+	struct puf_segment seg[PUF_MAX_SEGMENTS];
+	// An end address inside the last word of a window ends with the window
+	CHECK(puf_segments(0xD0000000, 0xDFFFFFFF, seg)==1);
+	CHECK(seg[0].start==0xD0000000 && seg[0].end==0xE0000000);
+	CHECK(puf_segments(0xCE000000, 0xCEFFFFFF, seg)==1);
+	CHECK(seg[0].start==0xCE000000 && seg[0].end==0xCF000000);
+	// Clipped to the first window, up to the word holding the end address
+	CHECK(puf_segments(0xC2000000, 0xC3001001, seg)==1);
+	CHECK(seg[0].start==0xC3000000 && seg[0].end==0xC3001004);
+}
+
+static void test_enter_sequence()
+{
+	const uint32_t cs=0x00200000 | SD_CS_DEL_KEEP_SET | SD_CS_SDUP_SET | SD_CS_RESTRT_SET;
+	sim_reset(cs);
+	struct pasr_masks m={0x10, 0x20, 0, 0};
+	pasr_enter(&m);
+
+	char expected_cs[32];
+	snprintf(expected_cs, sizeof(expected_cs), "SD_CS=%08X", 0x00200000 | SD_CS_SDUP_SET | SD_CS_STBY_SET);
+	CHECK(sim_logged==4);
+	CHECK(strcmp(sim_log[0], "MR16=10")==0);
+	CHECK(strcmp(sim_log[1], "MR17=20")==0);
+	CHECK(strcmp(sim_log[2], expected_cs)==0);
+	CHECK(strcmp(sim_log[3], "down")==0);
+	// Waits for the controller to go down, and stops polling right then
+	CHECK(!(sim_cs & SD_CS_SDUP_SET));
+	CHECK(sim_polls_down==0);
+}
+
+static void test_decay()
+{
+	sim_reset(SD_CS_SDUP_SET);
+	struct pasr_masks m={0x10, 0x00, 0, 0};
+	// 1 s at 1 ms per read of ST_CLO, the decay function every 100 ms from the start
+	pasr_decay(&m, 1, 1, 2000);
+	CHECK(sim_func_calls>=10 && sim_func_calls<=11);
+	// Only in self refresh
+	CHECK(sim_func_calls_up==0);
+	CHECK(sim_clo>=1000000);
+
+	sim_reset(SD_CS_SDUP_SET);
+	pasr_clear();
+	CHECK(sim_logged==2);
+	CHECK(strcmp(sim_log[0], "MR16=00")==0);
+	CHECK(strcmp(sim_log[1], "MR17=00")==0);
+}
+
+int main()
+{
+	test_choose_masks();
+	test_segments();
+	test_enter_sequence();
+	test_decay();
+	return failures==0 ? 0 : 1;
+}
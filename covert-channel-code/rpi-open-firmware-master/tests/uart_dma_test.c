@@ -0,0 +1,201 @@
+/**
+ * Host benchmark of the UART output through DMA (uart_dma.c), run by "make test": a readout is sent in chunks the
+ * way chunk.c does, against a simulated DMA channel and PL011, for a few baud rates and encoder costs per byte. Every
+ * byte has to arrive once and in order, the wire utilisation is printed like chunk_stats does.
+ *
+ *   uart_dma_test [MiB]    size of the readout, 4 by default, 1024 for a full dump
+**/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Only the bit definitions, the registers are simulated below
+#include "broadcom/bcm2708_chip/axi_dma0.h"
+#undef DMA0_CS
+#undef DMA0_CONBLK_AD
+
+static int failures=0;
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+static void check(bool ok, const char* what, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, line, what);
+		++failures;
+	}
+}
+
+/* The channel tops the FIFO up as soon as a byte has left it (DREQ), the UART sends one byte after the other at the
+ * baud rate. Time only passes with register accesses and the work of the encoder, a busy channel polled in a loop
+ * skips ahead to the next byte on the wire. */
+
+#define SIM_FIFO 16
+// One access of a peripheral register
+#define SIM_REG_NS 50
+
+static uint64_t sim_t;
+static uint64_t sim_byte_ns;
+// When the byte in front of the FIFO is on the wire, and when the last one was
+static uint64_t sim_wire_t, sim_done_t;
+static uint32_t sim_fifo;
+static uint32_t sim_cs, sim_cs_seen, sim_conblk;
+static const uint32_t* sim_src;
+static uint32_t sim_left;
+static uint64_t sim_queued, sim_sent, sim_transfers;
+
+static void sim_start_transfer();
+
+static uint8_t sim_byte(uint64_t k)
+{
+	return (uint8_t)(k ^ (k >> 8) ^ (k >> 16));
+}
+
+static void sim_advance(uint64_t to)
+{
+	uint64_t now=sim_t;
+	for (;;)
+	{
+		while (sim_left && sim_fifo<SIM_FIFO)
+		{
+			uint32_t word=*sim_src++;
+			CHECK(word==sim_byte(sim_sent+sim_fifo));
+			if (sim_fifo++==0)
+				sim_wire_t=now+sim_byte_ns;
+			if (--sim_left==0)
+				sim_cs=sim_cs_seen=DMA0_CS_END_SET;
+		}
+		if (sim_fifo==0 || sim_wire_t>to)
+			break;
+		now=sim_done_t=sim_wire_t;
+		sim_fifo--;
+		sim_sent++;
+		sim_wire_t+=sim_byte_ns;
+	}
+	if (to>sim_t)
+		sim_t=to;
+}
+
+// Takes in what was written since the last access, every access takes a while
+static void sim_access()
+{
+	if (sim_cs!=sim_cs_seen)
+	{
+		if ((sim_cs & DMA0_CS_ACTIVE_SET) && !sim_left)
+			sim_start_transfer();
+		else if (sim_cs==DMA0_CS_END_SET)
+			sim_cs=sim_left ? DMA0_CS_ACTIVE_SET : 0;
+		sim_cs_seen=sim_cs;
+	}
+	uint64_t to=sim_t+SIM_REG_NS;
+	if (sim_left && sim_fifo==SIM_FIFO && sim_wire_t>to)
+		to=sim_wire_t;
+	sim_advance(to);
+}
+
+static uint32_t* sim_dma_cs()
+{
+	sim_access();
+	return &sim_cs;
+}
+
+static uint32_t* sim_dma_conblk()
+{
+	sim_access();
+	return &sim_conblk;
+}
+
+static uint32_t sim_clo()
+{
+	sim_access();
+	return (uint32_t)(sim_t/1000);
+}
+
+#define DMA0_CS (*sim_dma_cs())
+#define DMA0_CONBLK_AD (*sim_dma_conblk())
+#define ST_CLO sim_clo()
+#define UART_BASE 0x7e201000
+// Host pointers, the control block keeps the low 32 bits of them
+#define L2_ALIAS(p) ((uintptr_t)(p))
+
+static uint32_t uart_tx_wait_us;
+
+#include "uart_dma.c"
+
+static void sim_start_transfer()
+{
+	CHECK(sim_conblk==(uint32_t)(uintptr_t)&uart_dma_cb);
+	CHECK(uart_dma_cb.source_ad==(uint32_t)(uintptr_t)uart_stage);
+	CHECK(uart_dma_cb.dest_ad==UART_BASE);
+	CHECK(uart_dma_cb.txfr_len>0 && uart_dma_cb.txfr_len<=sizeof(uart_stage) && uart_dma_cb.txfr_len%4==0);
+	sim_src=uart_stage;
+	sim_left=uart_dma_cb.txfr_len/4;
+	sim_transfers++;
+}
+
+static void sim_reset(uint32_t baud)
+{
+	sim_t=sim_wire_t=sim_done_t=0;
+	sim_byte_ns=10000000000ULL/baud;
+	sim_fifo=sim_cs=sim_cs_seen=sim_conblk=sim_left=0;
+	sim_queued=sim_sent=sim_transfers=0;
+	ring_in=ring_done=ring_busy=0;
+	uart_tx_wait_us=0;
+}
+
+static void sim_queue(uint8_t* buf, uint32_t len)
+{
+	for (uint32_t i=0; i<len; i++)
+		buf[i]=sim_byte(sim_queued++);
+	uart_write(buf, len);
+}
+
+/* Like chunk_send: 14 bytes of header, the payload and 4 bytes of CRC. The encoder takes cpu_ns per payload byte
+ * and polls the channel every CHUNK_POLL bytes, or not at all. */
+static void sim_readout(uint64_t size, uint32_t cpu_ns, uint32_t poll, uint64_t* total_ns)
+{
+	uint8_t buf[1024];
+	for (uint64_t done=0; done<size; done+=sizeof(buf))
+	{
+		for (uint32_t i=0; i<sizeof(buf); i+=poll)
+		{
+			sim_advance(sim_t+(uint64_t)poll*cpu_ns);
+			if (poll<sizeof(buf))
+				uart_poll();
+		}
+		sim_queue(buf, 14);
+		sim_queue(buf, sizeof(buf));
+		sim_queue(buf, 4);
+	}
+	uart_drain();
+	uint64_t drained_t=sim_t;
+	sim_advance(UINT64_MAX);
+	*total_ns=sim_done_t>drained_t ? sim_done_t : drained_t;
+	CHECK(sim_sent==sim_queued);
+}
+
+int main(int argc, char** argv)
+{
+	static const uint32_t bauds[]={115200, 921600, 1200000};
+	static const uint32_t cpu_ns[]={100, 500, 2000};
+	uint64_t size=(argc>1 ? strtoull(argv[1], NULL, 0) : 4) << 20;
+
+	printf("%llu MiB in chunks of 1 KiB, bursts of %d bytes, ring of %d bytes\n", (unsigned long long)(size >> 20),
+	       UART_DMA_WORDS, UART_RING_SIZE);
+	printf("%8s %8s %6s %12s %12s %10s\n", "baud", "ns/byte", "poll", "wire busy %", "time s", "transfers");
+	for (uint32_t b=0; b<sizeof(bauds)/sizeof(bauds[0]); b++)
+		for (uint32_t c=0; c<sizeof(cpu_ns)/sizeof(cpu_ns[0]); c++)
+			for (uint32_t poll=64; poll<=1024; poll*=16)
+			{
+				uint64_t total_ns;
+				sim_reset(bauds[b]);
+				sim_readout(size, cpu_ns[c], poll, &total_ns);
+				double busy=100.0*(double)(sim_sent*sim_byte_ns)/(double)total_ns;
+				printf("%8u %8u %6s %12.1f %12.1f %10llu\n", bauds[b], cpu_ns[c], poll<1024 ? "64" : "none", busy,
+				       (double)total_ns/1e9, (unsigned long long)sim_transfers);
+			}
+	return failures==0 ? 0 : 1;
+}
@@ -99,156 +99,22 @@ void sleh_fatal(vc4_saved_state_t* pcb, uint32_t n) {
 	hang_cpu();
 }
 
-extern int get_mode();
-extern void get_func_loc();
-extern void get_decay_func();
-extern void get_func_freq();
-extern void get_address_mode();
-extern void get_decay_time();
-extern void get_start_address();
-extern void get_end_address();
-extern void get_init_value();
-
-extern void execute_puf(int);
-
-extern void cpu_code();
-
-#define PUF_ARGS_AMT 8
-
-volatile int time=0;
-/**
- * flag_m: Mark workmode_set_status
- * flag_mm: Mark puf_extract_status
-**/
-volatile bool flag_m=0,flag_mm=0;
-volatile int mode=0;
+extern int get_job();
+
+extern int sched_irq();
+
+// Job taken from the kernel, run by monitor_start
+extern volatile int g_PendingJob;
+
 void sleh_irq(vc4_saved_state_t* pcb, uint32_t tp) 
 {
-	uint32_t status = IC0_S;
-	uint32_t source = status & 0xFF;
-	if (flag_m==0)
-	{
-		mode=get_mode();
-	}
-	else if (mode==0 && flag_m==1 && flag_mm==0)
-	{
-		time++;
-		switch (time%PUF_ARGS_AMT)
-		{
-			case  1: get_address_mode();
-					 break;
-			case  2: get_func_loc();
-					 break;
-			case  3: get_start_address();
-					 break;
-			case  4: get_end_address();
-					 break;
-			case  5: get_init_value();
-					 break;
-			case  6: get_decay_func();
-					 break;
-			case  7: get_func_freq();
-					 break;
-			case  0: get_decay_time();
-					 execute_puf(mode);
-					 flag_mm=1;
-					 time=0;
-					 break;
-			default: break;
-		}	
-	}
-	
-	else if (mode==1 && flag_m==1 && flag_mm==0) 
-	{
-		time++;
-		switch (time%PUF_ARGS_AMT)
-		{
-			case  1: get_address_mode();
-					 break;
-			case  2: get_func_loc();
-					 break;
-			case  3: get_start_address();
-					 break;
-			case  4: get_end_address();
-					 break;
-			case  5: get_init_value();
-					 break;
-			case  6: get_decay_func();
-					 break;
-			case  7: get_func_freq();
-					 break;
-			case  0: get_decay_time();
-					 execute_puf(mode);
-					 flag_mm=1;
-					 time=0;
-					 break;
-			default: break;
-		}	
-	} 
-	else if (mode==2 && flag_m==1 && flag_mm==0)
-	{
-		time++;
-		switch (time%PUF_ARGS_AMT)
-		{
-			case  1: get_address_mode();
-					 break;
-			case  2: get_func_loc();
-					 break;
-			case  3: get_start_address();
-					 break;
-			case  4: get_end_address();
-					 break;
-			case  5: get_init_value();
-					 break;
-			case  6: get_decay_func();
-					 break;
-			case  7: get_func_freq();
-					 break;
-			case  0: get_decay_time();
-					 execute_puf(mode);
-					 flag_mm=1;
-					 time=0;
-					 break;
-			default: break;
-		}	
-	}
-	else if (mode==3 && flag_m==1 && flag_mm==0)
-	{
-		time++;
-		switch (time%PUF_ARGS_AMT)
-		{
-			case  1: get_address_mode();
-                     break;
-			case  2: get_func_loc();
-					 break;
-			case  3: get_start_address();
-					 break;
-			case  4: get_end_address();
-					 break;
-			case  5: get_init_value();
-					 break;
-			case  6: get_decay_func();
-					 break;
-			case  7: get_func_freq();
-					 break;
-			case  0: get_decay_time();
-					 execute_puf(mode);
-					 flag_mm=1;
-					 time=0;
-					 break;
-			default: break;
-		}
-	}
-	else if (mode==4)
-	{
-		cpu_code();
-	}
-
-	if(flag_mm==1)
-	{
-		flag_m=0;
-		flag_mm=0;
-	}
-	else
-		flag_m=1;
-}
\ No newline at end of file
+	// The refresh timer during a decay, see getpuf/sched.c
+	if (sched_irq())
+		return;
+
+	// Every job comes as one parameter block, see get_job in arm_monitor.c. It runs outside of the interrupt, so
+	// the refresh timer can interrupt it
+	int mode = get_job();
+	if (mode >= 0)
+		g_PendingJob = mode;
+}
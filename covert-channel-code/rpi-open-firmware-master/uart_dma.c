@@ -0,0 +1,128 @@
+/*=============================================================================
+Copyright (C) 2016-2017 Authors of rpi-open-firmware
+All rights reserved.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+FILE DESCRIPTION
+Raw UART output through DMA channel 0, included by romstage.c and by the
+host benchmark tests/uart_dma_test.c.
+
+The DMA engine only writes whole words to the data register, one byte each.
+The bytes are queued packed in uart_ring and only spread out into uart_stage
+when a transfer starts, one burst of at most UART_DMA_WORDS at a time. The
+next burst is started when the channel is polled: uart_write does so while it
+queues, longer computations call uart_poll in between (see chunk.c).
+
+=============================================================================*/
+
+#define UART_DMACR        (UART_BASE+0x48)
+#define UART_DMACR_TXDMAE 0x2
+#define UART_DREQ_TX      12
+
+// Bytes sent by one transfer, 530 us on the wire at 1.2 Mbaud
+#define UART_DMA_WORDS  64
+// A few bursts, a power of two
+#define UART_RING_SIZE  (UART_DMA_WORDS * 8)
+#define UART_RING_MASK  (UART_RING_SIZE - 1)
+
+struct dma_cb {
+	uint32_t ti;
+	uint32_t source_ad;
+	uint32_t dest_ad;
+	uint32_t txfr_len;
+	uint32_t stride;
+	uint32_t nextconbk;
+	uint32_t reserved[2];
+};
+
+// Read by the DMA engine, so they are written through the L2-only alias and nothing stays in the L1 cache
+static struct dma_cb uart_dma_cb __attribute__((aligned(32)));
+static uint32_t uart_stage[UART_DMA_WORDS] __attribute__((aligned(32)));
+// Only seen by the CPU
+static uint8_t uart_ring[UART_RING_SIZE];
+// Free running: bytes queued and bytes staged, and bytes of the transfer in progress
+static uint32_t ring_in, ring_done, ring_busy;
+
+/**
+Description: Retire the finished transfer and start the next one from the ring, if the channel is idle.
+**/
+void uart_poll(void) {
+	if (ring_busy) {
+		if (DMA0_CS & DMA0_CS_ACTIVE_SET)
+			return;
+		ring_busy = 0;
+	}
+
+	uint32_t n = ring_in - ring_done;
+	if (n == 0)
+		return;
+	if (n > UART_DMA_WORDS)
+		n = UART_DMA_WORDS;
+
+	volatile uint32_t* stage = (volatile uint32_t*)L2_ALIAS(uart_stage);
+	for (uint32_t i = 0; i < n; i++)
+		stage[i] = uart_ring[ring_done++ & UART_RING_MASK];
+
+	volatile struct dma_cb* cb = (volatile struct dma_cb*)L2_ALIAS(&uart_dma_cb);
+	cb->ti = DMA0_TI_WAIT_RESP_SET | DMA0_TI_DEST_DREQ_SET | DMA0_TI_SRC_INC_SET |
+	         (UART_DREQ_TX << DMA0_TI_PERMAP_LSB);
+	cb->source_ad = L2_ALIAS(uart_stage);
+	cb->dest_ad = UART_BASE;
+	cb->txfr_len = n * 4;
+	cb->stride = 0;
+	cb->nextconbk = 0;
+	(void)cb->nextconbk; // Control block and burst written out before the engine loads them
+
+	ring_busy = n;
+	DMA0_CS = DMA0_CS_END_SET;
+	DMA0_CONBLK_AD = L2_ALIAS(cb);
+	DMA0_CS = DMA0_CS_ACTIVE_SET;
+}
+
+/**
+Description: Wait until everything queued by uart_write is in the FIFO, so text written directly comes after it.
+**/
+void uart_drain(void) {
+	while (ring_in != ring_done || ring_busy)
+		uart_poll();
+}
+
+/**
+Description: Send raw bytes. They are queued in the ring and sent by DMA while the caller goes on, it only waits
+			 once the ring is full.
+Input: buf, len
+**/
+void uart_write(const unsigned char* buf, unsigned int len) {
+	while (len > 0) {
+		uart_poll();
+		uint32_t space = UART_RING_SIZE - (ring_in - ring_done);
+		if (space == 0) {
+			uint32_t start = ST_CLO;
+			do {
+				uart_poll();
+				space = UART_RING_SIZE - (ring_in - ring_done);
+			} while (space == 0);
+			uart_tx_wait_us += ST_CLO - start;
+		}
+
+		// At most a burst between two checks of the channel
+		unsigned int n = len;
+		if (n > space)
+			n = space;
+		if (n > UART_DMA_WORDS)
+			n = UART_DMA_WORDS;
+		len -= n;
+		while (n-- > 0)
+			uart_ring[ring_in++ & UART_RING_MASK] = *buf++;
+	}
+	uart_poll();
+}